@@ -0,0 +1,604 @@
+// Microbenchmarks for BigNum operations
+//
+// Usage: bignum_bench [--format text|csv|json] [--filter <substring>]
+//                     [--min-time <ms>]
+//        bignum_bench --check
+//
+// Every operation runs over small, mid and extreme exponents, and a mix of
+// small and mid values, and reports ns/op and heap allocations/op. The vec_
+// benchmarks run the BigNumVector kernels (SIMD when built with AVX2 or
+// SSE4.2), for comparison with the scalar add, mul and compare. The csv and
+// json formats are meant for comparing runs from two commits.
+//
+// --check instead verifies results that earlier versions got wrong, and
+// exits with a failure if any differ. ctest runs it.
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <compare>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <format>
+#include <functional>
+#include <limits>
+#include <new>
+#include <print>
+#include <random>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <tuple>
+#include <vector>
+
+#include "../src/BigNum.hpp"
+
+// --- Allocation counting ---
+
+namespace {
+std::atomic<std::size_t> allocations{0};
+} // namespace
+
+void *operator new(std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+void *operator new[](std::size_t size) { return ::operator new(size); }
+void *operator new(std::size_t size, std::align_val_t align) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  std::size_t a = static_cast<std::size_t>(align);
+#ifdef _MSC_VER
+  void *p = _aligned_malloc(size == 0 ? 1 : size, a);
+#else
+  void *p = std::aligned_alloc(a, (size + a) / a * a);
+#endif
+  if (p) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+void *operator new[](std::size_t size, std::align_val_t align) {
+  return ::operator new(size, align);
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+
+static void aligned_free(void *p) {
+#ifdef _MSC_VER
+  _aligned_free(p);
+#else
+  std::free(p);
+#endif
+}
+void operator delete(void *p, std::align_val_t) noexcept { aligned_free(p); }
+void operator delete[](void *p, std::align_val_t) noexcept {
+  aligned_free(p);
+}
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept {
+  aligned_free(p);
+}
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept {
+  aligned_free(p);
+}
+
+namespace {
+
+// --- Harness ---
+
+// Keeps the compiler from optimizing away a computed value
+template <typename T> void keep(const T &value) {
+#if defined(__GNUC__) || defined(__clang__)
+  asm volatile("" : : "r,m"(value) : "memory");
+#else
+  static volatile char sink;
+  sink = *reinterpret_cast<const volatile char *>(&value);
+#endif
+}
+
+struct Result {
+  std::string name;
+  std::string range;
+  double ns_per_op;
+  double allocs_per_op;
+  std::uint64_t ops;
+};
+
+struct Options {
+  enum class Format { Text, Csv, Json } format = Format::Text;
+  std::string filter;
+  std::chrono::milliseconds min_time{200};
+};
+
+// Runs `body` (which performs `batch` operations) until min_time has passed
+Result measure(std::string_view name, std::string_view range,
+               std::size_t batch, const std::function<void()> &body,
+               const Options &options) {
+  using Clock = std::chrono::steady_clock;
+
+  body(); // Warm up
+
+  std::uint64_t ops = 0;
+  std::size_t allocs_before = allocations.load(std::memory_order_relaxed);
+  auto start = Clock::now();
+  auto elapsed = Clock::duration::zero();
+  while (elapsed < options.min_time) {
+    body();
+    ops += batch;
+    elapsed = Clock::now() - start;
+  }
+  std::size_t allocs =
+      allocations.load(std::memory_order_relaxed) - allocs_before;
+
+  double ns =
+      std::chrono::duration<double, std::nano>(elapsed).count();
+  return {std::string(name), std::string(range), ns / static_cast<double>(ops),
+          static_cast<double>(allocs) / static_cast<double>(ops), ops};
+}
+
+// --- Inputs ---
+
+static constexpr std::size_t N = 1024;
+
+struct Range {
+  std::string_view name;
+  std::vector<BigNum> a, b;
+  std::vector<std::string> strings;
+  BigNumVector va, vb; // a and b
+  // Output of vec_compare, allocated once
+  mutable std::vector<std::partial_ordering> order;
+};
+
+// small: integer counts below 2^53, mid: exponents up to 300, extreme:
+// exponents anywhere in the 64-bit range, mixed: small and mid alternating,
+// as integer amounts next to large ones
+std::vector<Range> makeRanges() {
+  std::mt19937_64 rng(42);
+  std::uniform_real_distribution<double> mantissa(1.0, 9.999);
+
+  auto small = [&]() {
+    return BigNum(static_cast<double>(rng() % 1'000'000));
+  };
+  auto mid = [&]() {
+    return BigNum(mantissa(rng), 17 + rng() % 284);
+  };
+  auto extreme = [&]() {
+    return BigNum(mantissa(rng), rng() >> 1);
+  };
+  bool odd = false;
+  auto mixed = [&]() {
+    odd = !odd;
+    return odd ? small() : mid();
+  };
+
+  std::vector<Range> ranges;
+  for (auto [name, gen] :
+       {std::pair<std::string_view, std::function<BigNum()>>{"small", small},
+        {"mid", mid},
+        {"extreme", extreme},
+        {"mixed", mixed}}) {
+    Range r{name, {}, {}, {}, {}, {}, {}};
+    for (std::size_t i = 0; i < N; ++i) {
+      r.a.push_back(gen());
+      r.b.push_back(gen());
+      r.strings.push_back(r.a.back().serialize());
+      r.va.push_back(r.a.back());
+      r.vb.push_back(r.b.back());
+    }
+    r.order.assign(N, std::partial_ordering::unordered);
+    ranges.push_back(std::move(r));
+  }
+  return ranges;
+}
+
+// --- Benchmarks ---
+
+using Bench = std::pair<std::string_view, std::function<void(const Range &)>>;
+
+std::vector<Bench> makeBenches() {
+  return {
+      {"normalize",
+       [](const Range &r) {
+         for (const auto &x : r.a) {
+           keep(BigNum(x.getM() * 1234.5, x.getE()));
+         }
+       }},
+      {"add",
+       [](const Range &r) {
+         for (std::size_t i = 0; i < N; ++i) {
+           keep(r.a[i] + r.b[i]);
+         }
+       }},
+      {"add_assign",
+       [](const Range &r) {
+         BigNum total = r.a[0];
+         for (const auto &x : r.b) {
+           total += x;
+         }
+         keep(total);
+       }},
+      {"sub",
+       [](const Range &r) {
+         for (std::size_t i = 0; i < N; ++i) {
+           keep(r.a[i] - r.b[i]);
+         }
+       }},
+      {"mul",
+       [](const Range &r) {
+         for (std::size_t i = 0; i < N; ++i) {
+           keep(r.a[i] * r.b[i]);
+         }
+       }},
+      {"div",
+       [](const Range &r) {
+         for (std::size_t i = 0; i < N; ++i) {
+           keep(r.a[i] / r.b[i]);
+         }
+       }},
+      {"compare",
+       [](const Range &r) {
+         for (std::size_t i = 0; i < N; ++i) {
+           keep(r.a[i] < r.b[i]);
+         }
+       }},
+      // The vec_ timings include copying the 1024 inputs
+      {"vec_add",
+       [](const Range &r) {
+         BigNumVector sum = r.va;
+         sum.add(r.vb);
+         keep(sum[0]);
+       }},
+      {"vec_mul",
+       [](const Range &r) {
+         BigNumVector product = r.va;
+         product.mul(r.vb);
+         keep(product[0]);
+       }},
+      {"vec_compare",
+       [](const Range &r) {
+         r.va.compare(r.vb, r.order);
+         keep(r.order[0]);
+       }},
+      {"pow",
+       [](const Range &r) {
+         for (const auto &x : r.a) {
+           keep(x.pow(1.5));
+         }
+       }},
+      {"root",
+       [](const Range &r) {
+         for (const auto &x : r.a) {
+           keep(x.root(3));
+         }
+       }},
+      {"to_string",
+       [](const Range &r) {
+         for (const auto &x : r.a) {
+           keep(x.to_string());
+         }
+       }},
+      {"format_to",
+       [](const Range &r) {
+         std::array<char, 64> buf;
+         for (const auto &x : r.a) {
+           keep(x.format_to(buf.data(), buf.data() + buf.size()).ptr);
+         }
+       }},
+      {"parse",
+       [](const Range &r) {
+         for (const auto &s : r.strings) {
+           keep(BigNum(s));
+         }
+       }},
+      {"from_chars",
+       [](const Range &r) {
+         BigNum value;
+         for (const auto &s : r.strings) {
+           keep(BigNum::from_chars(s.data(), s.data() + s.size(), value).ec);
+           keep(value);
+         }
+       }},
+  };
+}
+
+// --- Checks ---
+
+struct Checker {
+  int failures = 0;
+
+  void expect(bool passed, std::string_view name, std::string_view detail) {
+    if (!passed) {
+      std::println(stderr, "FAIL {}: {}", name, detail);
+      ++failures;
+    }
+  }
+
+  // `got` has exponent `e` and a mantissa within 1e-12 of `m`
+  template <typename Num>
+  void near(std::string_view name, const Num &got, double m,
+            std::uintmax_t e) {
+    bool passed = got.getE() == e &&
+                  std::abs(got.getM() - m) <= 1e-12 * std::abs(m);
+    expect(passed, name,
+           std::format("got {}e{}, expected {}e{}", got.getM(), got.getE(), m,
+                       e));
+  }
+};
+
+// Quotients below 1 stay in the mantissa; the exponent is unsigned
+template <typename Num> void checkDivision(Checker &c) {
+  c.near("4 / 10", Num(4) / Num(10), 0.4, 0);
+  Num quotient(4);
+  quotient /= Num(10);
+  c.near("4 /= 10", quotient, 0.4, 0);
+  c.near("3e5 / 4e5", Num(3.0, 5) / Num(4.0, 5), 0.75, 0);
+  c.near("5 / 1e307", Num(5) / Num(1.0, 307), 5e-307, 0);
+  c.near("1e10 / 1e317", Num(1.0, 10) / Num(1.0, 317), 1e-307, 0);
+  c.near("5 / 1e308", Num(5) / Num(1.0, 308), 0, 0); // MAX_DIV_DIFF
+}
+
+// Mantissas stay within [1, 10) whenever the exponent is above 0
+template <typename Num> void checkNormalize(Checker &c) {
+  c.near("1e400 / 2", Num(1.0, 400) / Num(2), 5.0, 399);
+  c.near("0.5e400", Num(0.5, 400), 5.0, 399);
+}
+
+// FastBigNum keeps fractions that BigNum rounds away, such as rates
+void checkFractional(Checker &c) {
+  c.near("1 * 3 * 0.5", FastBigNum(1) * FastBigNum(3) * FastBigNum(0.5), 1.5,
+         0);
+  c.near("5 * 0.75", FastBigNum(5) * FastBigNum(0.75), 3.75, 0);
+  c.near("0.5 to BigNum and back", FastBigNum(BigNum(FastBigNum(0.5))), 0.5,
+         0);
+  c.near("0.25e2 to FastBigNum", FastBigNum(BigNum(0.25, 2)), 2.5, 1);
+}
+
+// Upgrade costs round once, and never charge more than the budget
+void checkUpgradeCosts(Checker &c) {
+  c.near("geometric_sum(10, 1.15, 1, 1)",
+         BigNum::geometric_sum(BigNum(10), 1.15, BigNum(1), BigNum(1)), 1.2, 1);
+  c.near("geometric_sum(10, 1.15, 1, 1) (fast)",
+         FastBigNum::geometric_sum(FastBigNum(10), 1.15, FastBigNum(1),
+                                   FastBigNum(1)),
+         1.15, 1);
+  c.near("geometric_sum(10, 1.15, 1, 2)",
+         BigNum::geometric_sum(BigNum(10), 1.15, BigNum(1), BigNum(2)), 2.5, 1);
+  c.near("max_affordable(10, 4, 1, 0)",
+         BigNum::max_affordable(BigNum(10), BigNum(4), 1.0, BigNum(0)), 2, 0);
+  c.near("max_affordable(24, 10, 1.15, 1)",
+         BigNum::max_affordable(BigNum(24), BigNum(10), 1.15, BigNum(1)), 1,
+         0);
+
+  // Past a double: the quotient itself, which costs the whole budget
+  const BigNum budget(1.0, 400);
+  const BigNum levels =
+      BigNum::max_affordable(budget, BigNum(4), 1.0, BigNum(0));
+  c.near("max_affordable(1e400, 4, 1, 0)", levels, 2.5, 399);
+  c.expect(BigNum::geometric_sum(BigNum(4), 1.0, BigNum(0), levels) <= budget,
+           "geometric_sum(4, 1, 0, 2.5e399)", "more than the budget");
+
+  // Shrinking costs: 100 buys every level, so there is no maximum
+  c.expect(BigNum::max_affordable(BigNum(100), BigNum(10), 0.5, BigNum(0))
+               .is_nan(),
+           "max_affordable(100, 10, 0.5, 0)", "expected nan");
+  c.near("max_affordable(15, 10, 0.5, 0)",
+         BigNum::max_affordable(BigNum(15), BigNum(10), 0.5, BigNum(0)), 2,
+         0);
+}
+
+// BigNumVector gives the scalar results, on the vector path or not; small
+// integer lanes are stored in mantissa/exponent form and take it too
+void checkVector(Checker &c) {
+  for (const Range &r : makeRanges()) {
+    BigNumVector sum = r.va;
+    sum.add(r.vb);
+    BigNumVector product = r.va;
+    product.mul(r.vb);
+    BigNumVector fma = r.va;
+    fma.fma(r.va, r.vb);
+    r.va.compare(r.vb, r.order);
+
+    std::size_t differ = 0;
+    for (std::size_t i = 0; i < N; ++i) {
+      const BigNum &a = r.a[i];
+      const BigNum &b = r.b[i];
+      if (!(sum[i] == a + b) || !(product[i] == a * b) ||
+          !(fma[i] == a + a * b) || r.order[i] != (a <=> b)) {
+        ++differ;
+      }
+    }
+    c.expect(differ == 0, std::format("vector ops over {}", r.name),
+             std::format("{} of {} lanes differ from scalar", differ, N));
+  }
+}
+
+void checkFormat(Checker &c) {
+  auto same = [&c](std::string_view name, const std::string &got,
+                   std::string_view expected) {
+    c.expect(got == expected, name,
+             std::format("got \"{}\", expected \"{}\"", got, expected));
+  };
+  // Rounding carries into a new digit
+  same("99999999.96", BigNum(99999999.96).to_string(), "100000000");
+  // No leading zero from a mantissa below 1
+  same("0.3e1", BigNum(0.3, 1).to_string(), "3");
+  same("0.25e2", BigNum(0.25, 2).to_string(), "25");
+  same("0.25e1 (fast)", FastBigNum(0.25, 1).to_string(), "2.5");
+}
+
+// from_chars() follows std::from_chars: on invalid input nothing matched,
+// so ptr is `first`
+void checkParse(Checker &c) {
+  auto parse = [](std::string_view text) {
+    BigNum value(7);
+    auto result =
+        BigNum::from_chars(text.data(), text.data() + text.size(), value);
+    return std::tuple{result.ptr - text.data(), result.ec, value};
+  };
+  {
+    auto [end, ec, value] = parse("12e3");
+    c.expect(ec == std::errc() && end == 4 && value == BigNum(12000), "12e3",
+             std::format("read {} chars as {}", end, value.to_string()));
+  }
+  {
+    auto [end, ec, value] = parse("12abc");
+    c.expect(ec == std::errc() && end == 2 && value == BigNum(12), "12abc",
+             std::format("read {} chars", end));
+  }
+  for (std::string_view bad : {"abc", "1e", "1e+", "2.5E"}) {
+    auto [end, ec, value] = parse(bad);
+    c.expect(ec == std::errc::invalid_argument && end == 0 &&
+                 value == BigNum(7),
+             bad,
+             std::format("ptr at {}, value {}", end, value.to_string()));
+  }
+}
+
+// Keys order like the values, including mantissas left below 1
+void checkSortKey(Checker &c) {
+  auto below = [&c](std::string_view name, const BigNum &a, const BigNum &b) {
+    c.expect(a.sort_key() < b.sort_key(), name,
+             std::format("key of {} is not below key of {}", a.to_string(),
+                         b.to_string()));
+  };
+  below("-1 < 0", BigNum(-1), BigNum(0));
+  below("0.5 < 2", BigNum(0.5), BigNum(2));
+  below("1e300 < 1e400", BigNum(1.0, 300), BigNum(1.0, 400));
+  // A subnormal mantissa (about 4.9e-324) with a huge exponent is about
+  // 4.9e76, and needs a shift of 324, past the powers of 10 table
+  const auto subnormal = BigNum::from_bits(
+      std::bit_cast<std::uint64_t>(std::numeric_limits<double>::denorm_min()),
+      400);
+  c.expect(subnormal.has_value(), "subnormal mantissa", "invalid bits");
+  if (subnormal) {
+    below("4e76 < subnormal mantissa", BigNum(4.0, 76), *subnormal);
+    below("subnormal mantissa < 5e76", *subnormal, BigNum(5.0, 76));
+  }
+}
+
+int runChecks() {
+  Checker c;
+  checkDivision<BigNum>(c);
+  checkDivision<FastBigNum>(c);
+  checkNormalize<BigNum>(c);
+  checkNormalize<FastBigNum>(c);
+  checkFractional(c);
+  checkUpgradeCosts(c);
+  checkVector(c);
+  checkFormat(c);
+  checkParse(c);
+  checkSortKey(c);
+  if (c.failures > 0) {
+    std::println(stderr, "{} checks failed", c.failures);
+    return EXIT_FAILURE;
+  }
+  std::println("All checks passed");
+  return EXIT_SUCCESS;
+}
+
+// --- Output ---
+
+void print(const std::vector<Result> &results, Options::Format format) {
+  switch (format) {
+  case Options::Format::Text:
+    std::println("{:<12} {:<8} {:>12} {:>12} {:>12}", "benchmark", "range",
+                 "ns/op", "allocs/op", "ops");
+    for (const auto &r : results) {
+      std::println("{:<12} {:<8} {:>12.2f} {:>12.3f} {:>12}", r.name, r.range,
+                   r.ns_per_op, r.allocs_per_op, r.ops);
+    }
+    break;
+  case Options::Format::Csv:
+    std::println("benchmark,range,ns_per_op,allocs_per_op,ops");
+    for (const auto &r : results) {
+      std::println("{},{},{:.3f},{:.4f},{}", r.name, r.range, r.ns_per_op,
+                   r.allocs_per_op, r.ops);
+    }
+    break;
+  case Options::Format::Json:
+    std::println("[");
+    for (std::size_t i = 0; i < results.size(); ++i) {
+      const auto &r = results[i];
+      std::println("  {{\"benchmark\": \"{}\", \"range\": \"{}\", "
+                   "\"ns_per_op\": {:.3f}, \"allocs_per_op\": {:.4f}, "
+                   "\"ops\": {}}}{}",
+                   r.name, r.range, r.ns_per_op, r.allocs_per_op, r.ops,
+                   i + 1 < results.size() ? "," : "");
+    }
+    std::println("]");
+    break;
+  }
+}
+
+void usage(const char *program) {
+  std::println(stderr,
+               "Usage: {} [--format text|csv|json] [--filter <substring>] "
+               "[--min-time <ms>]\n       {} --check",
+               program, program);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc == 2 && std::string_view(argv[1]) == "--check") {
+    return runChecks();
+  }
+
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    std::string_view arg = argv[i];
+    if (i + 1 >= argc) {
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+    std::string_view value = argv[++i];
+    if (arg == "--format") {
+      if (value == "text") {
+        options.format = Options::Format::Text;
+      } else if (value == "csv") {
+        options.format = Options::Format::Csv;
+      } else if (value == "json") {
+        options.format = Options::Format::Json;
+      } else {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+      }
+    } else if (arg == "--filter") {
+      options.filter = value;
+    } else if (arg == "--min-time") {
+      int ms = 0;
+      auto [ptr, ec] =
+          std::from_chars(value.data(), value.data() + value.size(), ms);
+      if (ec != std::errc() || ms <= 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+      }
+      options.min_time = std::chrono::milliseconds(ms);
+    } else {
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  const auto ranges = makeRanges();
+  std::vector<Result> results;
+  for (const auto &[name, bench] : makeBenches()) {
+    if (!options.filter.empty() && !name.contains(options.filter)) {
+      continue;
+    }
+    for (const auto &range : ranges) {
+      results.push_back(measure(
+          name, range.name, N, [&] { bench(range); }, options));
+    }
+  }
+  print(results, options.format);
+  return EXIT_SUCCESS;
+}
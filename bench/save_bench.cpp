@@ -0,0 +1,155 @@
+// Save encoding benchmark
+//
+// Usage: save_bench [--items <count>] [--min-time <ms>]
+//
+// Encodes a save with `count` items (100000 by default, a few MB) in each
+// format, with and without LZ4, and reports encode throughput, the file
+// size, and the time to write the file. Compressing pays off when it saves
+// more write time than it costs: the "pays below" column is the disk speed
+// under which compressed saves finish first, including the write.
+
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <print>
+#include <string>
+#include <string_view>
+
+#include "../src/Logger.hpp"
+#include "../src/resources/SaveData.hpp"
+
+using namespace Save;
+
+std::ofstream &Logger::out() {
+  static std::ofstream log("save_bench.log");
+  return log;
+}
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+  std::size_t items = 100000;
+  std::chrono::milliseconds min_time{500};
+};
+
+// Seconds per call of `body`, averaged until min_time has passed
+double measure(const std::function<void()> &body, const Options &options) {
+  body(); // Warm up
+  std::size_t calls = 0;
+  auto start = Clock::now();
+  auto elapsed = Clock::duration::zero();
+  while (elapsed < options.min_time) {
+    body();
+    ++calls;
+    elapsed = Clock::now() - start;
+  }
+  return std::chrono::duration<double>(elapsed).count() /
+         static_cast<double>(calls);
+}
+
+// Long shared prefixes, as real item IDs have, and amounts across the range
+void fill(std::size_t items) {
+  SaveData &save = SaveData::instance();
+  for (std::size_t i = 0; i < items; ++i) {
+    save.setItem(std::format("refined material tier {} variant {}", i % 50, i),
+                 BigNum(1.0 + static_cast<double>(i % 997) / 997.0,
+                        static_cast<std::uintmax_t>(i % 500)));
+  }
+  for (std::size_t i = 0; i < items / 100; ++i) {
+    save.addUpgradeLvl(std::format("production speed upgrade {}", i),
+                       BigNum(static_cast<double>(i)));
+  }
+}
+
+void run(const Options &options) {
+  using Format = SaveData::Format;
+  using Compression = SaveData::Compression;
+  fill(options.items);
+  const auto snapshot = SaveData::instance().publish();
+  const auto path = std::filesystem::temp_directory_path() / "save_bench.dat";
+
+  std::println("{:<12} {:>10} {:>12} {:>12} {:>12} {:>12}", "format",
+               "size (KB)", "encode MB/s", "encode ms", "write ms",
+               "pays below");
+  for (Format format : {Format::Binary, Format::Json}) {
+    std::string plain;
+    double plainEncode = 0;
+    for (Compression compression : {Compression::None, Compression::Lz4}) {
+      std::string data;
+      double encode = measure(
+          [&] { data = SaveData::encode(*snapshot, format, compression); },
+          options);
+      // Through the page cache: what a fast disk's write costs at most
+      double write = measure(
+          [&] {
+            std::ofstream file(path, std::ios::binary);
+            file.write(data.data(), static_cast<std::streamsize>(data.size()));
+          },
+          options);
+
+      std::string name = format == Format::Binary ? "binary" : "json";
+      std::string paysBelow = "-";
+      if (compression == Compression::None) {
+        plain = data;
+        plainEncode = encode;
+      } else {
+        name += "+lz4";
+        // Compressed wins while (plain - compressed) / disk > extra time
+        double extra = encode - plainEncode;
+        double saved = static_cast<double>(plain.size() - data.size());
+        paysBelow = extra > 0 ? std::format("{:.0f} MB/s", saved / extra / 1e6)
+                              : "always";
+      }
+      std::println("{:<12} {:>10} {:>12.0f} {:>12.2f} {:>12.2f} {:>12}", name,
+                   data.size() / 1024,
+                   static_cast<double>(plain.size()) / encode / 1e6,
+                   encode * 1e3, write * 1e3, paysBelow);
+    }
+  }
+  std::filesystem::remove(path);
+}
+
+void usage(const char *program) {
+  std::println(stderr, "Usage: {} [--items <count>] [--min-time <ms>]",
+               program);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    std::string_view arg = argv[i];
+    if (i + 1 >= argc) {
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+    std::string_view value = argv[++i];
+    std::size_t number = 0;
+    auto [ptr, ec] =
+        std::from_chars(value.data(), value.data() + value.size(), number);
+    if (ec != std::errc() || number == 0) {
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+    if (arg == "--items") {
+      options.items = number;
+    } else if (arg == "--min-time") {
+      options.min_time =
+          std::chrono::milliseconds(static_cast<std::int64_t>(number));
+    } else {
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  run(options);
+  return EXIT_SUCCESS;
+}
@@ -10,19 +10,33 @@ the types of games that would use this library
 
 #include <algorithm>
 #include <array>
+#include <bit>
 #include <cassert>
+#include <charconv>
 #include <cmath>
 #include <compare>
+#include <concepts>
+#include <cstddef>
 #include <cstdint>
 #include <format>
-#include <iomanip>
+#include <functional>
+#include <initializer_list>
 #include <iostream>
 #include <limits>
+#include <new>
+#include <numbers>
 #include <optional>
-#include <sstream>
+#include <span>
 #include <string>
 #include <string_view>
+#include <system_error>
 #include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__SSE4_2__)
+#include <immintrin.h>
+#endif
 
 /* Define a macro for deducing CONSTEXPR_NEXTAFTER_FALLBACK
  * We do this because std::nextafter is not properly constepxr in most compilers
@@ -88,6 +102,12 @@ struct BigNumContext {
 // Global "default" context when none is passed to functions
 inline BigNumContext DefaultBigNumContext;
 
+// Output notation for BigNum::format_to
+enum class Notation {
+  Standard, // 1234567, 1.234e15
+  Pretty    // 1,234,567, 1.234e15
+};
+
 // Precompute powers-of-10 table for performance
 static inline constexpr int Pow10TableOffset =
     std::numeric_limits<double>::max_exponent10;
@@ -122,12 +142,91 @@ public:
   }
 };
 
-class BigNum {
+class BigNumVector;
+namespace expr {
+template <typename Policy> class Leaf;
+} // namespace expr
+template <typename Policy> class BasicBigNumAccumulator;
+
+// Unsigned 128-bit key from BasicBigNum::sort_key(), compared as (hi, lo)
+struct SortKey {
+  std::uint64_t hi = 0;
+  std::uint64_t lo = 0;
+
+  constexpr auto operator<=>(const SortKey &) const = default;
+
+  // i-th byte, least significant first
+  constexpr unsigned byte(unsigned i) const {
+    return static_cast<unsigned>((i < 8 ? lo >> (8 * i) : hi >> (8 * (i - 8))) &
+                                 0xff);
+  }
+};
+
+/* Normalization policies for BasicBigNum
+ * StrictPolicy: exact log10, clamps every result into [min(), max()] and
+ * rounds the mantissa to an integer while the exponent is below its decimal
+ * precision, so that small numbers stay exact. This is the default (BigNum).
+ * FastPolicy: estimates log10 from the double's exponent bits, only clamps on
+ * exponent overflow and keeps fractional mantissas as-is. Meant for simulation
+ * workloads where throughput matters more than exact small integers.
+ */
+struct StrictPolicy {
+  static inline constexpr bool clamp = true;
+  static inline constexpr bool round_small = true;
+
+  // floor(log10(x)) for x > 0
+  static MAYBE_CONSTEXPR int floor_log10(double x) {
+    assert(x > 0.0 && "x must be positive for log10");
+#if !CPP26
+    // Fallback to a division loop if std::log10 isn't constexpr
+    int exponent = 0;
+    while (x >= 10.0) {
+      x /= 10.0;
+      ++exponent;
+    }
+    while (x < 1.0) {
+      x *= 10.0;
+      --exponent;
+    }
+    return exponent;
+#else
+    return static_cast<int>(std::floor(std::log10(x)));
+#endif
+  }
+};
+
+struct FastPolicy {
+  static inline constexpr bool clamp = false;
+  static inline constexpr bool round_small = false;
+
+  // floor(log10(x)) for x > 0, estimated from the binary exponent and fixed up
+  // with at most one lookup in each direction
+  static MAYBE_CONSTEXPR int floor_log10(double x) {
+    assert(x > 0.0 && "x must be positive for log10");
+    int bexp = static_cast<int>((std::bit_cast<std::uint64_t>(x) >> 52) &
+                                0x7ff) -
+               1023;
+    int n = static_cast<int>(std::floor(bexp * 0.30102999566398120));
+    n = std::clamp(n, -Pow10TableOffset, Pow10TableOffset - 1);
+    if (x >= Pow10::Pow10Table[n + 1 + Pow10TableOffset]) {
+      ++n;
+    } else if (x < Pow10::Pow10Table[n + Pow10TableOffset]) {
+      --n;
+    }
+    return n;
+  }
+};
+
+template <typename Policy> class BasicBigNum {
   using man_t = double;    // mantissa type
   using exp_t = uintmax_t; // exponent type
 
-  friend std::ostream &operator<<(std::ostream &os, const BigNum &bn);
-  friend std::istream &operator>>(std::istream &is, BigNum &bn);
+  template <typename P>
+  friend std::istream &operator>>(std::istream &is, BasicBigNum<P> &bn);
+  template <typename P> friend class BasicBigNum;
+  friend class BigNumVector;
+  friend class expr::Leaf<Policy>;
+  friend class BasicBigNumAccumulator<Policy>;
 
 private:
   man_t m = 0; // mantissa
@@ -138,55 +237,98 @@ private:
                 "exponent must be an arithmetic type");
 
   static inline constexpr exp_t MAX_DIV_DIFF = 308;
-  // helper functions to convert strings to mantissa/exponent
-  static inline MAYBE_CONSTEXPR man_t strtom(const std::string_view &sv) {
-    man_t m;
-    auto result = std::from_chars(sv.data(), sv.data() + sv.size(), m);
-    if (result.ec != std::errc()) {
-      throw std::invalid_argument("Failed to convert string to mantissa: " +
-                                  std::string(sv));
+
+  // Small values: integers with |value| <= SMALL_MAX are stored exactly, as
+  // an int64_t in the exponent bits, with the mantissa set to a NaN payload
+  // that arithmetic never produces. Results that don't fit are promoted to
+  // the mantissa/exponent form.
+  static inline constexpr std::uint64_t SMALL_TAG = 0x7ffc'0000'0000'0001;
+  static inline constexpr std::int64_t SMALL_MAX = std::int64_t{1} << 53;
+
+  MAYBE_CONSTEXPR bool is_small() const {
+    return std::bit_cast<std::uint64_t>(m) == SMALL_TAG;
+  }
+  MAYBE_CONSTEXPR std::int64_t small() const {
+    return std::bit_cast<std::int64_t>(e);
+  }
+
+  // Builds a small value, or promotes it if |value| > SMALL_MAX
+  static MAYBE_CONSTEXPR BasicBigNum from_int(std::int64_t value) {
+    if (value >= -SMALL_MAX && value <= SMALL_MAX) {
+      return BasicBigNum(std::bit_cast<man_t>(SMALL_TAG),
+                         std::bit_cast<exp_t>(value), false);
     }
-    return m;
+    return BasicBigNum(static_cast<man_t>(value), 0, true);
   }
-  static inline MAYBE_CONSTEXPR exp_t strtoe(const std::string_view &sv) {
-    exp_t e;
-    auto result = std::from_chars(sv.data(), sv.data() + sv.size(), e);
-    if (result.ec != std::errc()) {
-      throw std::invalid_argument("Failed to convert string to exponent: " +
-                                  std::string(sv));
+
+  // Returns this number in mantissa/exponent form
+  MAYBE_CONSTEXPR BasicBigNum big() const {
+    if (!is_small()) {
+      return *this;
     }
-    return e;
+    return BasicBigNum(static_cast<man_t>(small()), 0, true);
   }
 
-  // convert the number to a full-precision string
-  static MAYBE_CONSTEXPR std::string to_string_full(const man_t &value) {
-    std::ostringstream out;
-    out << std::setprecision(std::numeric_limits<man_t>::digits10 + 1) << value;
-    return out.str();
+  // Closest double to this number (+-inf if it doesn't fit)
+  MAYBE_CONSTEXPR double as_double() const {
+    if (is_small()) {
+      return static_cast<double>(small());
+    }
+    return m * std::pow(10.0, static_cast<double>(e));
   }
 
-  // convert double to string, rounding down and up to specific precision
-  static MAYBE_CONSTEXPR std::string to_string_floor(const double &value,
-                                                     const int &precision) {
-    // Assumes value is normalized to 1 digit before the decimal point
-    // (|value| < 10)
-    assert(value > -10 && value < 10 && "Value must be normalized");
-    double scale = std::pow(10.0, precision);
-    double truncated_value = std::floor(value * scale) / scale;
+  // Builds 10^lg (sign > 0) or -10^lg (sign < 0)
+  static MAYBE_CONSTEXPR BasicBigNum from_log10(double lg, double sign = 1) {
+    if (std::isnan(lg)) {
+      return nan();
+    }
+    if (lg < std::numeric_limits<man_t>::max_exponent10) {
+      return BasicBigNum(sign * std::pow(10.0, lg));
+    }
+    if (lg >= static_cast<double>(std::numeric_limits<exp_t>::max())) {
+      return sign > 0 ? max() : min();
+    }
+    double whole = std::floor(lg);
+    return BasicBigNum(sign * std::pow(10.0, lg - whole),
+                       static_cast<exp_t>(whole));
+  }
 
-    std::ostringstream out;
-    out << std::fixed << std::setprecision(precision) << truncated_value;
-    std::string out_str = out.str();
+  // Writes `sv` into [first, last)
+  static std::to_chars_result write_chars(char *first, char *last,
+                                          std::string_view sv) {
+    if (static_cast<std::size_t>(last - first) < sv.size()) {
+      return {last, std::errc::value_too_large};
+    }
+    return {std::copy(sv.begin(), sv.end(), first), std::errc()};
+  }
 
-    // If necessary, round down to always return 1 digit before the decimal
-    // point This is to avoid rounding errors when the number is close to 10
-    // Should always be correct given our assumption that |value| < 10
-    if (out_str.substr(0, 3) == "10"s + DECIMAL_SEPARATOR) {
-      out_str = "9"s + DECIMAL_SEPARATOR + std::string(precision, '9');
-    } else if (out_str.substr(0, 4) == "-10"s + DECIMAL_SEPARATOR) {
-      out_str = "-9"s + DECIMAL_SEPARATOR + std::string(precision, '9');
+  // Inserts thousands separators into the integer digits in [first, end)
+  static std::to_chars_result group_thousands(char *first, char *end,
+                                              char *last) {
+    std::string_view str(first, end);
+
+    // Scientific notation and fractional numbers are not affected
+    if (str.contains('e') || str.contains(DECIMAL_SEPARATOR)) {
+      return {end, std::errc()};
+    }
+
+    char *digits = first + (str.starts_with('-') ? 1 : 0);
+    std::size_t n_digits = static_cast<std::size_t>(end - digits);
+    std::size_t n_separators = n_digits > 0 ? (n_digits - 1) / 3 : 0;
+    if (static_cast<std::size_t>(last - end) < n_separators) {
+      return {last, std::errc::value_too_large};
+    }
+
+    // Shift digits right from the back, dropping a separator every 3 digits
+    char *src = end;
+    char *dst = end + n_separators;
+    for (std::size_t i = 1; src != digits; ++i) {
+      *--dst = *--src;
+      if (i % 3 == 0 && src != digits) {
+        *--dst = THOUSANDS_SEPARATOR;
+      }
     }
-    return out_str;
+    return {end + n_separators, std::errc()};
   }
 
 // Fallback implemnetation in case of non-std::nextafter
@@ -226,24 +368,7 @@ private:
   }
 #endif
 
-// Fallback to std::log10 if not on C++26
-#if !CPP26
-  static int _log10(double x) {
-    assert(x > 0.0 && "x must be positive for log10");
-    int exponent = 0;
-    while (x >= 10.0) {
-      x /= 10.0;
-      ++exponent;
-    }
-    while (x < 1.0) {
-      x *= 10.0;
-      --exponent;
-    }
-    return exponent;
-  }
-#endif
-
-  MAYBE_CONSTEXPR BigNum(const man_t mantissa, const exp_t exponent,
+  MAYBE_CONSTEXPR BasicBigNum(const man_t mantissa, const exp_t exponent,
                          bool normalize)
       : m(mantissa), e(exponent) {
     if (normalize)
@@ -251,86 +376,249 @@ private:
   }
 
   MAYBE_CONSTEXPR void parseStr(const std::string_view &sv) {
-    try {
-      size_t pos = sv.find('e');
-      if (pos != std::string::npos) {
-        m = strtom(sv.substr(0, pos));
-        e = strtoe(sv.substr(pos + 1));
-      } else {
-        m = strtom(sv);
-        e = 0;
-      }
-      normalize();
-    } catch (const std::invalid_argument &ex) {
-      throw std::invalid_argument(std::string("Failed to parse number: ") +
-                                  ex.what());
+    if (from_chars(sv.data(), sv.data() + sv.size(), *this).ec !=
+        std::errc()) {
+      throw std::invalid_argument("Failed to parse number: " +
+                                  std::string(sv));
     }
   }
 
-  MAYBE_CONSTEXPR void set(const BigNum &other) {
+  MAYBE_CONSTEXPR void set(const BasicBigNum &other) {
     m = other.m;
     e = other.e;
   }
 
+  std::to_chars_result format_standard(char *first, char *last,
+                                       const unsigned int &precision) const {
+    if (is_small()) {
+      return big().format_standard(first, last, precision);
+    }
+    if (this->is_inf()) {
+      return write_chars(first, last, "inf");
+    }
+    if (this->is_nan()) {
+      return write_chars(first, last, "nan");
+    }
+
+    // Values built outside normalize() (e.g. by kernels) are formatted in
+    // normalized form, so the digit count always matches the exponent
+    if ((std::abs(m) >= 10.0 || (std::abs(m) < 1.0 && m != 0 && e > 0))) {
+      BasicBigNum normalized = *this;
+      normalized.normalize();
+      if (normalized.m != m || normalized.e != e) {
+        return normalized.format_standard(first, last, precision);
+      }
+    }
+
+    // Handle small numbers directly
+    if (e == 0) {
+
+      // Round down to specified precision
+      double scale = *Pow10::get(precision);
+      double rounded = std::floor(m * scale) / scale;
+
+      int digits = precision > 0 ? static_cast<int>(precision) - 1 : 0;
+      auto result = std::to_chars(first, last, rounded,
+                                  std::chars_format::fixed, digits);
+      if (result.ec != std::errc() || digits == 0) {
+        return result;
+      }
+
+      // Remove trailing zeroes and the decimal point if it's the last character
+      while (result.ptr[-1] == '0') {
+        --result.ptr;
+      }
+      if (result.ptr[-1] == '.') {
+        --result.ptr;
+      }
+      return result;
+    }
+
+    // Can this number be fully displayed as a string <= max_digits long?
+    // Assumes m and e are already normalized
+    unsigned int max_digits =
+        std::max(precision + 1, DefaultBigNumContext.max_digits);
+    if (this->e < max_digits - 1) {
+      // Full-precision digits of the mantissa, without the decimal separator
+      std::array<char, 32> full;
+      char *full_end =
+          std::to_chars(full.data(), full.data() + full.size(), m,
+                        std::chars_format::general,
+                        std::numeric_limits<man_t>::digits10 + 1)
+              .ptr;
+      full_end = std::remove(full.data(), full_end, '.');
+      std::size_t len = static_cast<std::size_t>(full_end - full.data());
+
+      // calculate new length based on
+      std::size_t new_len =
+          static_cast<std::size_t>(
+              std::min(static_cast<exp_t>(max_digits), e + 1)) +
+          (full[0] == '-' ? 1 : 0);
+
+      // Reserve one extra character in case rounding carries into a new digit
+      if (static_cast<std::size_t>(last - first) < new_len + 1) {
+        return {last, std::errc::value_too_large};
+      }
+
+      // If the string is shorter than the desired length, pad with zeros
+      if (len <= new_len) {
+        char *out = std::copy(full.data(), full_end, first);
+        return {std::fill_n(out, new_len - len, '0'), std::errc()};
+      }
+
+      // If the string is longer than the desired length, truncate it,
+      // and round the last digit if necessary
+      char *out = std::copy_n(full.data(), new_len, first);
+      if (full[new_len] >= '5') {
+        char *digit = out;
+        while (digit != first && *(digit - 1) == '9') {
+          *--digit = '0';
+        }
+        if (digit != first && *(digit - 1) != '-') {
+          *(digit - 1) += 1;
+        } else {
+          // All digits were 9s: 999.9 -> 1000
+          std::copy_backward(digit, out, out + 1);
+          *digit = '1';
+          ++out;
+        }
+      }
+      return {out, std::errc()};
+    }
+
+    // Otherwise, use scientific notation, rounding the mantissa down
+    double scale = std::pow(10.0, precision);
+    double truncated = std::floor(m * scale) / scale;
+    auto result = std::to_chars(first, last, truncated,
+                                std::chars_format::fixed,
+                                static_cast<int>(precision));
+    if (result.ec != std::errc()) {
+      return result;
+    }
+
+    // If necessary, round down to always return 1 digit before the decimal
+    // point This is to avoid rounding errors when the number is close to 10
+    // Should always be correct given our assumption that |value| < 10
+    std::string_view m_str(first, result.ptr);
+    if (m_str.starts_with("10.") || m_str.starts_with("-10.")) {
+      char *out = first + (m_str[0] == '-' ? 1 : 0);
+      *out++ = '9';
+      *out++ = DECIMAL_SEPARATOR;
+      result.ptr = std::fill_n(out, precision, '9');
+    }
+
+    if (e != 0) {
+      if (result.ptr == last) {
+        return {last, std::errc::value_too_large};
+      }
+      *result.ptr++ = 'e';
+      result = std::to_chars(result.ptr, last, e);
+    }
+    return result;
+  }
+
+  std::string format_string(const unsigned int &precision,
+                            Notation notation) const {
+    // Enough for default contexts, and within std::string's small buffer for
+    // most in-game numbers
+    std::array<char, 64> buf;
+    auto [end, ec] =
+        format_to(buf.data(), buf.data() + buf.size(), precision, notation);
+    if (ec == std::errc()) {
+      return std::string(buf.data(), end);
+    }
+
+    // Very large precision or max_digits: size the buffer for the worst case
+    std::string str(static_cast<std::size_t>(precision) +
+                        DefaultBigNumContext.max_digits + 64,
+                    '\0');
+    end = format_to(str.data(), str.data() + str.size(), precision, notation)
+              .ptr;
+    str.resize(static_cast<std::size_t>(end - str.data()));
+    return str;
+  }
+
 public:
-  static MAYBE_CONSTEXPR const BigNum &inf() {
-    static BigNum inf_val(std::numeric_limits<man_t>::infinity(), 0, false);
+  static MAYBE_CONSTEXPR const BasicBigNum &inf() {
+    static BasicBigNum inf_val(std::numeric_limits<man_t>::infinity(), 0,
+                               false);
 
     return inf_val;
   }
-  static MAYBE_CONSTEXPR const BigNum &nan() {
-    static BigNum nan_val(std::numeric_limits<man_t>::quiet_NaN(), 0, false);
+  static MAYBE_CONSTEXPR const BasicBigNum &nan() {
+    static BasicBigNum nan_val(std::numeric_limits<man_t>::quiet_NaN(), 0,
+                               false);
 
     return nan_val;
   }
-  static MAYBE_CONSTEXPR const BigNum &max() {
+  static MAYBE_CONSTEXPR const BasicBigNum &max() {
 #if defined(CONSTEXPR_NEXTAFTER_FALLBACK) && !defined(_MSC_VER)
-    static const BigNum max_val(_prev_double(10.0),
+    static const BasicBigNum max_val(_prev_double(10.0),
                                 std::numeric_limits<exp_t>::max(), false);
 #else
-    static const BigNum max_val(std::nextafter(10.0, 0.0),
+    static const BasicBigNum max_val(std::nextafter(10.0, 0.0),
                                 std::numeric_limits<exp_t>::max(), false);
 #endif
 
     return max_val;
   }
-  static MAYBE_CONSTEXPR const BigNum &min() {
+  static MAYBE_CONSTEXPR const BasicBigNum &min() {
 #if defined(CONSTEXPR_NEXTAFTER_FALLBACK) && !defined(_MSC_VER)
-    static const BigNum min_val(_next_double(-10.0),
+    static const BasicBigNum min_val(_next_double(-10.0),
                                 std::numeric_limits<exp_t>::max(), false);
 #else
-    static const BigNum min_val(std::nextafter(-10.0, 0.0),
+    static const BasicBigNum min_val(std::nextafter(-10.0, 0.0),
                                 std::numeric_limits<exp_t>::max(), false);
 #endif
 
     return min_val;
   }
 
-  man_t getM() const { return m; }
-  exp_t getE() const { return e; }
+  // Mantissa and exponent of the normalized form, even for small values
+  man_t getM() const { return big().m; }
+  exp_t getE() const { return big().e; }
 
-  MAYBE_CONSTEXPR BigNum(const man_t mantissa, const exp_t exponent = 0) {
+  // Integral values within SMALL_MAX are stored as small values
+  MAYBE_CONSTEXPR BasicBigNum(const man_t mantissa, const exp_t exponent = 0) {
     m = mantissa;
     e = exponent;
+    if (e == 0 && std::abs(m) <= static_cast<man_t>(SMALL_MAX) &&
+        m == std::trunc(m)) {
+      set(from_int(static_cast<std::int64_t>(m)));
+      return;
+    }
     normalize();
   }
 
-  MAYBE_CONSTEXPR BigNum(const std::string_view &str) { parseStr(str); }
+  MAYBE_CONSTEXPR BasicBigNum(const std::string_view &str) { parseStr(str); }
+
+  // Conversion between normalization policies
+  template <typename P>
+  MAYBE_CONSTEXPR explicit BasicBigNum(const BasicBigNum<P> &other)
+      : m(other.m), e(other.e) {
+    normalize();
+  }
 
   // Default methods to satisfy concepts
-  MAYBE_CONSTEXPR BigNum() : m(0), e(0) { normalize(); } // Default constructor
-  BigNum(const BigNum &) = default;                      // Copy constructor
-  BigNum &operator=(const BigNum &) = default;           // Copy assignment
-  BigNum(BigNum &&) = default;                           // Move constructor
-  BigNum &operator=(BigNum &&) = default;                // Move assignment
+  MAYBE_CONSTEXPR BasicBigNum()
+      : m(std::bit_cast<man_t>(SMALL_TAG)), e(0) {}     // Default constructor
+  BasicBigNum(const BasicBigNum &) = default;            // Copy constructor
+  BasicBigNum &operator=(const BasicBigNum &) = default; // Copy assignment
+  BasicBigNum(BasicBigNum &&) = default;                 // Move constructor
+  BasicBigNum &operator=(BasicBigNum &&) = default;      // Move assignment
 
-  ~BigNum() = default; // Destructor
+  ~BasicBigNum() = default; // Destructor
 
   // Normalization: mantissa set in range (-10, 10)
   MAYBE_CONSTEXPR void normalize() {
-    if (*this == max() || *this == min()) {
+    if (is_small()) {
       return;
     }
+    if constexpr (Policy::clamp) {
+      if (*this == max() || *this == min()) {
+        return;
+      }
+    }
     if (std::isnan(m)) {
       e = 0;
       return;
@@ -347,37 +635,60 @@ public:
       return;
     }
 
-    // Start normalization
-    int n_log;
-#if !CPP26
-    n_log = std::max(_log10(std::abs(m)), 0);
-#else
-    n_log = std::max(static_cast<int>(std::floor(std::log10(std::abs(m)))), 0);
-#endif
-
-    // if (n_log < 0) { n_log = 0; }
+    // Start normalization. Mantissas below 1 shift down as far as the
+    // exponent allows, since it can't go below 0.
+    int n_log = Policy::floor_log10(std::abs(m));
+    if (n_log < 0) {
+      n_log = -static_cast<int>(std::min(
+          e, static_cast<exp_t>(std::min(-n_log, Pow10TableOffset))));
+    }
     m = m / (*Pow10::get(n_log));
-    e += n_log;
 
-    // Clamp between max and min
-    if (*this > max()) {
-      set(max());
-    }
-    if (*this < min()) {
-      set(min());
+    if (n_log < 0) {
+      e -= static_cast<exp_t>(-n_log);
+    } else if constexpr (Policy::clamp) {
+      e += n_log;
+
+      // Clamp between max and min
+      if (*this > max()) {
+        set(max());
+      }
+      if (*this < min()) {
+        set(min());
+      }
+    } else {
+      // Only clamp if the exponent would overflow
+      if (e > std::numeric_limits<exp_t>::max() - static_cast<exp_t>(n_log)) {
+        set(m > 0 ? max() : min());
+        return;
+      }
+      e += n_log;
     }
 
     // Disregard fractional part if exponent is under mantissa's max decimal
     // precision
-    if (e < std::numeric_limits<man_t>::max_digits10) {
-      double target_precision = Pow10::get(e).value_or(1.0);
-      m = std::round(m * target_precision) / target_precision;
-      // m = std::floor(m * target_precision) / target_precision;
+    if constexpr (Policy::round_small) {
+      if (e < std::numeric_limits<man_t>::max_digits10) {
+        double target_precision = Pow10::get(e).value_or(1.0);
+        m = std::round(m * target_precision) / target_precision;
+        // Rounding may carry into a new digit: 9.99999999 -> 10
+        if (std::abs(m) >= 10.0) {
+          m /= 10.0;
+          ++e;
+        }
+      }
     }
   }
 
   // Arithmetic operations
-  MAYBE_CONSTEXPR BigNum add(const BigNum &b) const {
+  MAYBE_CONSTEXPR BasicBigNum add(const BasicBigNum &b) const {
+    // Small values: |a + b| <= 2^54 can't overflow
+    if (is_small() && b.is_small()) {
+      return from_int(small() + b.small());
+    }
+    if (is_small() || b.is_small()) {
+      return big().add(b.big());
+    }
 
     // Handle special cases early
     auto m_inf = std::numeric_limits<man_t>::infinity();
@@ -389,22 +700,24 @@ public:
     }
 
     // Handle max and min cases early
-    if (*this == max() && b.m > 0.0f) {
-      return max();
-    }
-    if (m > 0.0f && b == max()) {
-      return max();
-    }
-    if (*this == min() && b.m < 0.0f) {
-      return min();
-    }
-    if (m < 0.0f && b == min()) {
-      return min();
+    if constexpr (Policy::clamp) {
+      if (*this == max() && b.m > 0.0f) {
+        return max();
+      }
+      if (m > 0.0f && b == max()) {
+        return max();
+      }
+      if (*this == min() && b.m < 0.0f) {
+        return min();
+      }
+      if (m < 0.0f && b == min()) {
+        return min();
+      }
     }
 
     // Handle simple case: both exponents are zero
     if (e == 0 && b.e == 0) {
-      return BigNum(m + b.m, 0);
+      return BasicBigNum(m + b.m, 0);
     }
 
     // Handle general case
@@ -423,18 +736,36 @@ public:
       e2 = e;
     }
 
-    return BigNum(m2, e2);
+    return BasicBigNum(m2, e2);
   }
 
-  MAYBE_CONSTEXPR BigNum sub(const BigNum &b) const {
-    return add(BigNum(b.m * -1, b.e));
+  MAYBE_CONSTEXPR BasicBigNum sub(const BasicBigNum &b) const {
+    if (b.is_small()) {
+      return add(from_int(-b.small()));
+    }
+    return add(BasicBigNum(b.m * -1, b.e));
   }
 
-  MAYBE_CONSTEXPR BigNum mul(const BigNum &b) const {
-    return BigNum(m * b.m, e + b.e);
+  MAYBE_CONSTEXPR BasicBigNum mul(const BasicBigNum &b) const {
+    if (is_small() && b.is_small()) {
+      // The double product is close enough to tell if the exact one fits
+      man_t product =
+          static_cast<man_t>(small()) * static_cast<man_t>(b.small());
+      if (std::abs(product) <= static_cast<man_t>(SMALL_MAX)) {
+        return from_int(small() * b.small());
+      }
+    }
+    if (is_small() || b.is_small()) {
+      return big().mul(b.big());
+    }
+    return BasicBigNum(m * b.m, e + b.e);
   }
 
-  MAYBE_CONSTEXPR BigNum div(const BigNum &b) const {
+  MAYBE_CONSTEXPR BasicBigNum div(const BasicBigNum &b) const {
+    if (is_small() || b.is_small()) {
+      return big().div(b.big());
+    }
+
     // Division by zero, return NaN
     if (b.m == 0) {
       return nan();
@@ -442,20 +773,42 @@ public:
 
     // Divisor is significantly larger than dividend, result is 0
     if ((b.e > e) && (b.e - e >= MAX_DIV_DIFF)) {
-      return BigNum(static_cast<man_t>(0));
+      return BasicBigNum(static_cast<man_t>(0));
+    }
+
+    // Quotient below the exponent range: keep it in the mantissa
+    if (b.e > e) {
+      return BasicBigNum(m / b.m *
+                         *Pow10::get(-static_cast<int>(b.e - e)));
     }
 
     // Perform division
-    return BigNum(m / b.m, e - b.e);
+    return BasicBigNum(m / b.m, e - b.e);
   }
 
-  MAYBE_CONSTEXPR BigNum abs() const { return BigNum(std::abs(m), e); }
+  MAYBE_CONSTEXPR BasicBigNum abs() const {
+    if (is_small()) {
+      return from_int(small() < 0 ? -small() : small());
+    }
+    return BasicBigNum(std::abs(m), e);
+  }
 
-  MAYBE_CONSTEXPR BigNum negate() const {
-    return mul(BigNum(static_cast<man_t>(-1)));
+  MAYBE_CONSTEXPR BasicBigNum negate() const {
+    if (is_small()) {
+      return from_int(-small());
+    }
+    return mul(BasicBigNum(static_cast<man_t>(-1)));
   }
 
-  MAYBE_CONSTEXPR BigNum &operator+=(const BigNum &b) {
+  MAYBE_CONSTEXPR BasicBigNum &operator+=(const BasicBigNum &b) {
+    if (is_small() && b.is_small()) {
+      set(from_int(small() + b.small()));
+      return *this;
+    }
+    if (is_small() || b.is_small()) {
+      set(big());
+      return *this += b.big();
+    }
     bool this_is_bigger = e > b.e;
     exp_t delta = this_is_bigger ? e - b.e : b.e - e;
     if (delta > 14) {
@@ -472,14 +825,22 @@ public:
     return *this;
   }
 
-  MAYBE_CONSTEXPR BigNum &operator*=(const BigNum &b) {
+  MAYBE_CONSTEXPR BasicBigNum &operator*=(const BasicBigNum &b) {
+    if (is_small() || b.is_small()) {
+      set(mul(b));
+      return *this;
+    }
     m *= b.m;
     e += b.e;
     normalize();
     return *this;
   }
 
-  MAYBE_CONSTEXPR BigNum &operator/=(const BigNum &b) {
+  MAYBE_CONSTEXPR BasicBigNum &operator/=(const BasicBigNum &b) {
+    if (is_small() || b.is_small()) {
+      set(big());
+      return *this /= b.big();
+    }
     if (b.m == 0) {
       // Division by zero, return NaN
       m = nan().m;
@@ -488,6 +849,10 @@ public:
       // Divisor is significantly larger than dividend, result is 0
       m = 0;
       e = 0;
+    } else if (b.e > e) {
+      // Quotient below the exponent range: keep it in the mantissa
+      m = m / b.m * *Pow10::get(-static_cast<int>(b.e - e));
+      e = 0;
     } else {
       // Perform division
       m /= b.m;
@@ -498,105 +863,116 @@ public:
   }
 
   // Operator overloads
-  MAYBE_CONSTEXPR BigNum operator+(const BigNum &other) const {
+  MAYBE_CONSTEXPR BasicBigNum operator+(const BasicBigNum &other) const {
     return add(other);
   }
-  MAYBE_CONSTEXPR BigNum operator+(const std::string_view &other) const {
-    return add(BigNum(other));
+  MAYBE_CONSTEXPR BasicBigNum operator+(const std::string_view &other) const {
+    return add(BasicBigNum(other));
   }
-  MAYBE_CONSTEXPR BigNum operator+(const man_t other) const {
-    return add(BigNum(other));
+  MAYBE_CONSTEXPR BasicBigNum operator+(const man_t other) const {
+    return add(BasicBigNum(other));
   }
-  MAYBE_CONSTEXPR BigNum operator-(const BigNum &other) const {
+  MAYBE_CONSTEXPR BasicBigNum operator-(const BasicBigNum &other) const {
     return sub(other);
   }
-  MAYBE_CONSTEXPR BigNum operator-(const std::string_view &other) const {
-    return sub(BigNum(other));
+  MAYBE_CONSTEXPR BasicBigNum operator-(const std::string_view &other) const {
+    return sub(BasicBigNum(other));
   }
-  MAYBE_CONSTEXPR BigNum operator-(const man_t other) const {
-    return sub(BigNum(other));
+  MAYBE_CONSTEXPR BasicBigNum operator-(const man_t other) const {
+    return sub(BasicBigNum(other));
   }
-  MAYBE_CONSTEXPR BigNum operator*(const BigNum &other) const {
+  MAYBE_CONSTEXPR BasicBigNum operator*(const BasicBigNum &other) const {
     return mul(other);
   }
-  MAYBE_CONSTEXPR BigNum operator*(const std::string_view &other) const {
-    return mul(BigNum(other));
+  MAYBE_CONSTEXPR BasicBigNum operator*(const std::string_view &other) const {
+    return mul(BasicBigNum(other));
   }
-  MAYBE_CONSTEXPR BigNum operator*(const man_t other) const {
-    return mul(BigNum(other));
+  MAYBE_CONSTEXPR BasicBigNum operator*(const man_t other) const {
+    return mul(BasicBigNum(other));
   }
-  MAYBE_CONSTEXPR BigNum operator/(const BigNum &other) const {
+  MAYBE_CONSTEXPR BasicBigNum operator/(const BasicBigNum &other) const {
     return div(other);
   }
-  MAYBE_CONSTEXPR BigNum operator/(const std::string_view &other) const {
-    return div(BigNum(other));
+  MAYBE_CONSTEXPR BasicBigNum operator/(const std::string_view &other) const {
+    return div(BasicBigNum(other));
   }
-  MAYBE_CONSTEXPR BigNum operator/(const man_t other) const {
-    return div(BigNum(other));
+  MAYBE_CONSTEXPR BasicBigNum operator/(const man_t other) const {
+    return div(BasicBigNum(other));
   }
-  MAYBE_CONSTEXPR BigNum operator-() const { return negate(); }
-  MAYBE_CONSTEXPR BigNum &operator+=(const std::string_view &b) {
-    return *this += BigNum(b);
+  MAYBE_CONSTEXPR BasicBigNum operator-() const { return negate(); }
+  MAYBE_CONSTEXPR BasicBigNum &operator+=(const std::string_view &b) {
+    return *this += BasicBigNum(b);
   }
-  MAYBE_CONSTEXPR BigNum &operator+=(const man_t b) {
-    return *this += BigNum(b);
+  MAYBE_CONSTEXPR BasicBigNum &operator+=(const man_t b) {
+    return *this += BasicBigNum(b);
   }
-  MAYBE_CONSTEXPR BigNum &operator-=(const BigNum &b) {
-    return *this += BigNum(b.m * -1, b.e);
+  MAYBE_CONSTEXPR BasicBigNum &operator-=(const BasicBigNum &b) {
+    return *this += b.negate();
   }
-  MAYBE_CONSTEXPR BigNum &operator-=(const std::string_view &b) {
-    return *this -= BigNum(b);
+  MAYBE_CONSTEXPR BasicBigNum &operator-=(const std::string_view &b) {
+    return *this -= BasicBigNum(b);
   }
-  MAYBE_CONSTEXPR BigNum &operator-=(const man_t b) {
-    return *this -= BigNum(b);
+  MAYBE_CONSTEXPR BasicBigNum &operator-=(const man_t b) {
+    return *this -= BasicBigNum(b);
   }
-  MAYBE_CONSTEXPR BigNum &operator*=(const std::string_view &b) {
-    return *this *= BigNum(b);
+  MAYBE_CONSTEXPR BasicBigNum &operator*=(const std::string_view &b) {
+    return *this *= BasicBigNum(b);
   }
-  MAYBE_CONSTEXPR BigNum &operator*=(const man_t b) {
-    return *this *= BigNum(b);
+  MAYBE_CONSTEXPR BasicBigNum &operator*=(const man_t b) {
+    return *this *= BasicBigNum(b);
   }
-  MAYBE_CONSTEXPR BigNum &operator/=(const std::string_view &b) {
-    return *this /= BigNum(b);
+  MAYBE_CONSTEXPR BasicBigNum &operator/=(const std::string_view &b) {
+    return *this /= BasicBigNum(b);
   }
-  MAYBE_CONSTEXPR BigNum &operator/=(const man_t b) {
-    return *this /= BigNum(b);
+  MAYBE_CONSTEXPR BasicBigNum &operator/=(const man_t b) {
+    return *this /= BasicBigNum(b);
   }
-  MAYBE_CONSTEXPR BigNum &operator++() {
-    return *this += BigNum(static_cast<man_t>(1));
+  MAYBE_CONSTEXPR BasicBigNum &operator++() {
+    return *this += BasicBigNum(static_cast<man_t>(1));
   }
-  MAYBE_CONSTEXPR BigNum operator++(int) {
-    BigNum temp(*this);
-    *this += BigNum(static_cast<man_t>(1));
+  MAYBE_CONSTEXPR BasicBigNum operator++(int) {
+    BasicBigNum temp(*this);
+    *this += BasicBigNum(static_cast<man_t>(1));
     return temp;
   }
-  MAYBE_CONSTEXPR BigNum &operator--() {
-    return *this -= BigNum(static_cast<man_t>(1));
+  MAYBE_CONSTEXPR BasicBigNum &operator--() {
+    return *this -= BasicBigNum(static_cast<man_t>(1));
   }
-  MAYBE_CONSTEXPR BigNum operator--(int) {
-    BigNum temp(*this);
-    *this -= BigNum(static_cast<man_t>(1));
+  MAYBE_CONSTEXPR BasicBigNum operator--(int) {
+    BasicBigNum temp(*this);
+    *this -= BasicBigNum(static_cast<man_t>(1));
     return temp;
   }
 
   // Comparison operations
-  MAYBE_CONSTEXPR bool is_positive() const { return m >= 0; }
-  MAYBE_CONSTEXPR bool is_negative() const { return m < 0; }
+  MAYBE_CONSTEXPR bool is_positive() const {
+    return is_small() ? small() >= 0 : m >= 0;
+  }
+  MAYBE_CONSTEXPR bool is_negative() const {
+    return is_small() ? small() < 0 : m < 0;
+  }
   MAYBE_CONSTEXPR bool is_inf() const { return std::isinf(m); }
-  MAYBE_CONSTEXPR bool is_nan() const { return std::isnan(m); }
-  static MAYBE_CONSTEXPR BigNum &max(BigNum &a, BigNum &b) {
+  MAYBE_CONSTEXPR bool is_nan() const { return !is_small() && std::isnan(m); }
+  static MAYBE_CONSTEXPR BasicBigNum &max(BasicBigNum &a, BasicBigNum &b) {
     return a > b ? a : b;
   }
-  static MAYBE_CONSTEXPR BigNum &min(BigNum &a, BigNum &b) {
+  static MAYBE_CONSTEXPR BasicBigNum &min(BasicBigNum &a, BasicBigNum &b) {
     return a < b ? a : b;
   }
 
-  MAYBE_CONSTEXPR std::partial_ordering operator<=>(const BigNum &b) const {
+  MAYBE_CONSTEXPR std::partial_ordering
+  operator<=>(const BasicBigNum &b) const {
+    if (is_small() && b.is_small())
+      return small() <=> b.small();
+    if (is_small() || b.is_small())
+      return big() <=> b.big();
+
     if (is_nan() || b.is_nan())
       return std::partial_ordering::unordered;
 
-    if (is_inf() && b.is_inf())
-      return std::partial_ordering::equivalent;
+    // Infinities have a zero exponent, so only their mantissas compare
+    if (is_inf() || b.is_inf())
+      return m <=> b.m;
 
     if (m == b.m && e == b.e)
       return std::partial_ordering::equivalent;
@@ -623,158 +999,164 @@ public:
         return std::partial_ordering::less;
       if (e < b.e)
         return std::partial_ordering::greater;
+      // Mantissas are signed, so they compare directly
       if (m > b.m)
-        return std::partial_ordering::less;
-      return std::partial_ordering::greater; // m != b.m, and m < b.m
+        return std::partial_ordering::greater;
+      return std::partial_ordering::less; // m != b.m, and m < b.m
     }
   }
   // Equality operator (only use this under the assumption that the numbers
   // are already normalized)
-  MAYBE_CONSTEXPR bool operator==(const BigNum &other) const = default;
+  MAYBE_CONSTEXPR bool operator==(const BasicBigNum &other) const {
+    if (is_small() != other.is_small()) {
+      return big() == other.big();
+    }
+    if (is_small()) {
+      return e == other.e;
+    }
+    return m == other.m && e == other.e;
+  }
 
   MAYBE_CONSTEXPR std::partial_ordering
   operator<=>(const std::string_view &other) const {
-    return *this <=> BigNum(other);
+    return *this <=> BasicBigNum(other);
   }
   MAYBE_CONSTEXPR std::partial_ordering operator<=>(const man_t other) const {
-    return *this <=> BigNum(other);
+    return *this <=> BasicBigNum(other);
   }
 
   // Conversion methods
-  std::string to_string(const unsigned int &precision =
-                            DefaultBigNumContext.print_precision) const {
-    if (this->is_inf()) {
-      return "inf";
-    }
-    if (this->is_nan()) {
-      return "nan";
+
+  // Writes the number into [first, last) without allocating, in the same
+  // format as to_string() or to_pretty_string(). Like std::to_chars, returns
+  // {last, std::errc::value_too_large} if the range is too small.
+  std::to_chars_result format_to(
+      char *first, char *last,
+      const unsigned int &precision = DefaultBigNumContext.print_precision,
+      Notation notation = Notation::Standard) const {
+    auto result = format_standard(first, last, precision);
+    if (result.ec != std::errc() || notation != Notation::Pretty) {
+      return result;
     }
+    return group_thousands(first, result.ptr, last);
+  }
 
-    // Handle small numbers directly
-    if (e == 0) {
+  std::string to_string(const unsigned int &precision =
+                            DefaultBigNumContext.print_precision) const {
+    return format_string(precision, Notation::Standard);
+  }
 
-      // Round down to specified precision
-      double scale = *Pow10::get(precision);
-      double rounded = std::floor(m * scale) / scale;
+  // Pretty string: 1234567 -> 1,234,567
+  // Scientific notation is not affected
+  std::string to_pretty_string(const unsigned int &precision =
+                                   DefaultBigNumContext.print_precision) const {
+    return format_string(precision, Notation::Pretty);
+  }
 
-      // Use std::format for fixed precision and predictable output
-      std::string str = std::format("{:.{}f}", rounded, precision - 1);
+  // Parses "X" or "XeY" from [first, last) without throwing or allocating.
+  // Like std::from_chars, returns a pointer to the first unparsed character
+  // and an error code; `value` is only modified on success.
+  static std::from_chars_result from_chars(const char *first, const char *last,
+                                           BasicBigNum &value) {
+    man_t m;
+    auto result = std::from_chars(first, last, m, std::chars_format::fixed);
+    if (result.ec != std::errc()) {
+      return result;
+    }
 
-      // Remove trailing zeroes and the decimal point if it's the last character
-      size_t last_nonzero_pos = str.find_last_not_of('0');
-      if (last_nonzero_pos != std::string::npos) {
-        if (str[last_nonzero_pos] == '.') {
-          // Remove the decimal point if it's the last character after trimming
-          // zeros
-          str.resize(last_nonzero_pos);
-        } else {
-          // Trim trailing zeros
-          str.resize(last_nonzero_pos + 1);
-        }
+    exp_t e = 0;
+    if (result.ptr != last && (*result.ptr == 'e' || *result.ptr == 'E')) {
+      auto exp_result = std::from_chars(result.ptr + 1, last, e);
+      if (exp_result.ec == std::errc::invalid_argument) {
+        // No exponent digits after the 'e': nothing matched, as in "1e"
+        return {first, std::errc::invalid_argument};
       }
-
-      return str;
+      if (exp_result.ec != std::errc()) {
+        return exp_result;
+      }
+      result.ptr = exp_result.ptr;
     }
 
-    // Can this number be fully displayed as a string <= max_digits long?
-    // Assumes m and e are already normalized
-    unsigned int max_digits =
-        std::max(precision + 1, DefaultBigNumContext.max_digits);
-    if (this->e < max_digits - 1) {
-      std::string str = to_string_full(m);
-
-      // calculate new length based on
-      exp_t newLen = std::min(static_cast<exp_t>(max_digits), e + 1) +
-                     (str[0] == '-' ? 1 : 0);
+    value = BasicBigNum(m, e);
+    return result;
+  }
 
-      // Remove the decimal separator if it exists (and isn't small number
-      // <1)
-      str.erase(std::remove_if(str.begin(), str.end(),
-                               [](char c) { return c == DECIMAL_SEPARATOR; }),
-                str.end());
+  // Unsigned key that orders the same way as <=> for all finite values, with
+  // -inf and +inf at either end (NaN sorts with +inf). It has to be 128 bits
+  // wide: the exponent alone takes 64. Mantissas left below 1 with a positive
+  // exponent are canonicalized first, so equal values get equal keys.
+  MAYBE_CONSTEXPR SortKey sort_key() const {
+    if (is_small()) {
+      return big().sort_key();
+    }
+    if (std::isnan(m) || m == std::numeric_limits<man_t>::infinity()) {
+      return {~std::uint64_t{0}, ~std::uint64_t{0}};
+    }
+    if (std::isinf(m)) {
+      return {0, 0};
+    }
+    if (m == 0) {
+      return {std::uint64_t{1} << 63, 0};
+    }
 
-      // If the string is shorter than the desired length, pad with zeros
-      if (str.length() < newLen) {
-        str += std::string(newLen - str.length(), '0');
-      } else {
-        // If the string is longer than the desired length, truncate it,
-        // and round the last digit if necessary
-        bool round_up = false;
-
-        int first_unused_digit_pos = (str.length() > newLen) ? newLen : -1;
-        int first_unused_digit = (first_unused_digit_pos > 0)
-                                     ? int(str[first_unused_digit_pos] - '0')
-                                     : -1;
-
-        if (first_unused_digit >= 5) {
-          // Round up the last digit
-          round_up = true;
-        }
-        str = str.substr(0, newLen);
-        if (round_up) {
-          assert(!str.empty() && "String should not be empty after truncation");
-          str[str.length() - 1] += 1;
-        }
+    man_t mag = std::abs(m);
+    exp_t exp = e;
+    if (mag < 1 && exp > 0) {
+      int shift = static_cast<int>(std::min<exp_t>(
+          exp, static_cast<exp_t>(-Policy::floor_log10(mag))));
+      exp -= static_cast<exp_t>(shift);
+      // A subnormal mantissa needs a shift past the table (up to 324), so
+      // scale it in steps the table covers
+      while (shift > 0) {
+        const int step = std::min(shift, Pow10TableOffset);
+        mag *= *Pow10::get(step);
+        shift -= step;
       }
-      return str;
     }
 
-    // Otherwise, use scientific notation
-    std::ostringstream out;
-    // out << std::fixed << std::setprecision(precision) << m;
-
-    // Handle max() and min() specifically due to rounding issues
-    // std::string m_str;
-    // if (*this == max()) { m_str = std::string("9.") +
-    // std::string(precision, '9'); } else if (*this == min()) { m_str =
-    // std::string("-9.") + std::string(precision, '9'); } else { m_str =
-    // to_string_floor(m, precision); }
-
-    // Trim the result to the desired precision
-    // std::string m_str = to_string_floor(m, 2);
-    // size_t dot_pos = m_str.find('.');
-    // if (dot_pos != std::string::npos && dot_pos + precision + 1 <
-    // m_str.size()) {
-    //     m_str = m_str.substr(0, dot_pos + precision + 1);
-    // }
-    std::string m_str = to_string_floor(m, precision);
-    out << m_str;
-
-    if (e != 0) {
-      out << "e" << e;
+    // Sign, then exponent, then the mantissa's bits, which order like the
+    // mantissa itself since it is positive
+    const std::uint64_t bits = std::bit_cast<std::uint64_t>(mag);
+    SortKey key{(std::uint64_t{1} << 63) | (exp >> 1), (exp << 63) | bits};
+    if (m < 0) {
+      key = {~key.hi, ~key.lo};
     }
-
-    return out.str();
+    return key;
   }
 
-  // Pretty string: 1234567 -> 1,234,567
-  // Scientific notation is not affected
-  std::string to_pretty_string(const unsigned int &precision =
-                                   DefaultBigNumContext.print_precision) const {
-    std::string str = to_string(precision);
-
-    // Early exit if in scientific notation or if the number is too small
-    if (str.contains('e') || str.contains(DECIMAL_SEPARATOR)) {
-      return str;
-    }
-    if (str.length() < 4) {
-      return str;
-    }
+  // Raw bit patterns of the mantissa and exponent, for bit-exact binary
+  // storage. Opaque: only meant to be passed back to from_bits().
+  std::pair<std::uint64_t, std::uint64_t> to_bits() const {
+    return {std::bit_cast<std::uint64_t>(m), e};
+  }
 
-    // Insert thousands separators
-    for (size_t i = str.length() - 3; i > 0; i -= 3) {
-      str.insert(i, 1, THOUSANDS_SEPARATOR);
+  // Inverse of to_bits(), or nullopt if the bits aren't a valid number
+  static std::optional<BasicBigNum> from_bits(std::uint64_t m_bits,
+                                              std::uint64_t e_bits) {
+    BasicBigNum n(std::bit_cast<man_t>(m_bits), e_bits, false);
+    if (n.is_small() && (n.small() < -SMALL_MAX || n.small() > SMALL_MAX)) {
+      return std::nullopt;
     }
-    return str;
+    return n;
   }
 
   // Standard methods for (de)serialization
   std::string serialize() const { return to_string(SERIAL_PRECISION); }
 
-  static BigNum deserialize(const std::string_view &str) { return BigNum(str); }
+  // serialize() into [first, last) without allocating; 64 bytes always fit
+  std::to_chars_result serialize_to(char *first, char *last) const {
+    return format_to(first, last, SERIAL_PRECISION);
+  }
+
+  static BasicBigNum deserialize(const std::string_view &str) {
+    return BasicBigNum(str);
+  }
 
   // Returns number as intmax_t, or nullopt if the number is too large
   MAYBE_CONSTEXPR std::optional<intmax_t> to_number() const {
+    if (is_small()) {
+      return small();
+    }
     int total_digits = static_cast<int>(e + std::log10(std::abs(m)) + 1);
     if (total_digits > std::numeric_limits<intmax_t>::digits10) {
       // std::cerr << "Number is too large to convert to intmax_t: " <<
@@ -794,6 +1176,9 @@ public:
 
   // Returns log10(num), or nullopt if the result would be too large
   MAYBE_CONSTEXPR std::optional<double> log10() const {
+    if (is_small()) {
+      return big().log10();
+    }
     if (std::numeric_limits<double>::max() - e < std::log10(m)) {
       return std::nullopt;
     }
@@ -801,16 +1186,19 @@ public:
   }
 
   // Returns num^power
-  MAYBE_CONSTEXPR BigNum pow(double power) const {
+  MAYBE_CONSTEXPR BasicBigNum pow(double power) const {
+    if (is_small()) {
+      return big().pow(power);
+    }
     // Special cases
     if (power == 0.0) {
-      return BigNum(static_cast<man_t>(1));
+      return BasicBigNum(static_cast<man_t>(1));
     }
     if (m == 0) {
       if (power < 0) {
         throw std::domain_error("Cannot raise 0 to a negative power");
       }
-      return BigNum(static_cast<man_t>(0));
+      return BasicBigNum(static_cast<man_t>(0));
     }
 
     // When the mantissa is negative
@@ -825,16 +1213,16 @@ public:
 
       // Handle integer powers of negative numbers
       if (std::fmod(std::round(power), 2.0) == 0.0) {
-        return BigNum(-m, e).pow(power); // Even power
+        return BasicBigNum(-m, e).pow(power); // Even power
       }
-      return BigNum(-m, e).pow(power).negate(); // Odd power
+      return BasicBigNum(-m, e).pow(power).negate(); // Odd power
     }
 
     // Calculate using logarithms
     auto log = log10();
     if (!log) {
       // std::cerr << "Logarithm out of bounds" << std::endl;
-      return BigNum(static_cast<man_t>(0));
+      return BasicBigNum(static_cast<man_t>(0));
     }
 
     // Calculate new logarithm
@@ -843,28 +1231,31 @@ public:
     // Check if result would be too small
     if (std::abs(new_log) < std::numeric_limits<double>::min_exponent10) {
       // std::cerr << "Result too small" << std::endl;
-      return BigNum(static_cast<man_t>(0));
+      return BasicBigNum(static_cast<man_t>(0));
     }
 
     // Split into mantissa and exponent
     man_t m2 = static_cast<man_t>(std::pow(10, std::fmod(new_log, 1.0)));
     exp_t e2 = static_cast<exp_t>(std::floor(new_log));
 
-    return BigNum(m2, e2);
+    return BasicBigNum(m2, e2);
   }
 
   // Integer power overload - just calls the double version
-  MAYBE_CONSTEXPR BigNum pow(intmax_t power) const {
+  MAYBE_CONSTEXPR BasicBigNum pow(intmax_t power) const {
     return pow(static_cast<double>(power));
   }
 
   // Returns num^(1/n), aka the nth root
-  MAYBE_CONSTEXPR BigNum root(intmax_t n) const {
+  MAYBE_CONSTEXPR BasicBigNum root(intmax_t n) const {
+    if (is_small()) {
+      return big().root(n);
+    }
     if (n == 0) {
       throw std::domain_error("Cannot take the zeroth root");
     } // Handle zero early
     if (m == 0) {
-      return BigNum(static_cast<man_t>(0));
+      return BasicBigNum(static_cast<man_t>(0));
     }
     // Handle negative numbers: Only allow odd roots for negative bases
     bool is_negative = (m < 0);
@@ -892,30 +1283,131 @@ public:
       new_m = -new_m;
     }
 
-    return BigNum(new_m, new_e);
+    return BasicBigNum(new_m, new_e);
   }
 
   // Returns e^num
-  static MAYBE_CONSTEXPR BigNum exp(exp_t n) {
-    return BigNum(std::exp(1)).pow(static_cast<intmax_t>(n));
+  static MAYBE_CONSTEXPR BasicBigNum exp(exp_t n) {
+    return BasicBigNum(std::exp(1)).pow(static_cast<intmax_t>(n));
   }
 
   // Returns the square root of num
-  MAYBE_CONSTEXPR BigNum sqrt() const { return root(2); }
+  MAYBE_CONSTEXPR BasicBigNum sqrt() const { return root(2); }
+
+  // Geometric costs: level k of an upgrade costs base * ratio^k.
+  // Both functions work in the log domain, in O(1) regardless of the count.
+
+  // Total cost of `count` levels starting at level `start`:
+  // base * ratio^start * (ratio^count - 1) / (ratio - 1)
+  // The sum is rounded once, as the policy normalizes the result: with
+  // BigNum a total below 1e17 is a whole number (10 * 1.15 is 12), which is
+  // what gets charged. FastBigNum keeps the fraction (11.5).
+  static MAYBE_CONSTEXPR BasicBigNum geometric_sum(const BasicBigNum &base,
+                                                   double ratio,
+                                                   const BasicBigNum &start,
+                                                   const BasicBigNum &count) {
+    if (base.is_nan() || !(ratio > 0) || start.is_negative() ||
+        count.is_negative()) {
+      return nan();
+    }
+    if (count == BasicBigNum() || base == BasicBigNum()) {
+      return BasicBigNum();
+    }
+    if (ratio == 1.0) {
+      return base * count;
+    }
+
+    // log10(|ratio^count - 1| / |ratio - 1|), without overflowing ratio^count
+    const double lr = std::log10(ratio);
+    const double n = count.as_double();
+    const double x = n * lr * std::numbers::ln10;
+    const double lsum =
+        (x > 0 ? n * lr + std::log10(-std::expm1(-x))
+               : std::log10(-std::expm1(x))) -
+        std::log10(std::abs(ratio - 1.0));
+
+    const double lg =
+        *base.abs().log10() + start.as_double() * lr + lsum;
+    return from_log10(lg, base.is_negative() ? -1 : 1);
+  }
+
+  // Highest number of levels, starting at level `owned`, whose
+  // geometric_sum() is within `budget`. Returns nan() if ratio < 1 and the
+  // budget covers every remaining level, as there is no finite maximum.
+  static MAYBE_CONSTEXPR BasicBigNum max_affordable(const BasicBigNum &budget,
+                                                    const BasicBigNum &base,
+                                                    double ratio,
+                                                    const BasicBigNum &owned) {
+    if (budget.is_nan() || base.is_nan() || !(ratio > 0) ||
+        owned.is_negative() || !(base > BasicBigNum())) {
+      return nan();
+    }
+    if (!(budget > BasicBigNum())) {
+      return BasicBigNum();
+    }
+    if (ratio == 1.0) {
+      // Divided unrounded, so the floor doesn't see 2.5 rounded up to 3
+      const BasicBigNum<FastPolicy> times =
+          BasicBigNum<FastPolicy>(budget) / BasicBigNum<FastPolicy>(base);
+      if (times >= BasicBigNum<FastPolicy>(static_cast<double>(SMALL_MAX))) {
+        // Whole at this magnitude, and as_double() overflows past 1e308
+        return BasicBigNum(times);
+      }
+      return BasicBigNum(std::floor(times.as_double()));
+    }
+
+    // Solve budget = cost(owned) * |ratio^n - 1| / |ratio - 1| for n
+    const double lr = std::log10(ratio);
+    const double q = *budget.log10() + std::log10(std::abs(ratio - 1.0)) -
+                     *base.log10() - owned.as_double() * lr;
+    double n;
+    if (ratio > 1.0) {
+      // log10(1 + 10^q), which is q itself past double precision
+      n = (q > std::numeric_limits<double>::digits10
+               ? q
+               : std::log1p(std::pow(10.0, q)) / std::numbers::ln10) /
+          lr;
+    } else {
+      if (q >= 0) {
+        return nan();
+      }
+      n = std::log1p(-std::pow(10.0, q)) / std::numbers::ln10 / lr;
+    }
+    n = std::floor(n);
+
+    // Correct rounding errors of the closed form while counts are exact
+    if (n < static_cast<double>(SMALL_MAX)) {
+      BasicBigNum count(n);
+      if (geometric_sum(base, ratio, owned, count) > budget && n > 0) {
+        return count - BasicBigNum(1.0);
+      }
+      if (geometric_sum(base, ratio, owned, count + BasicBigNum(1.0)) <=
+          budget) {
+        return count + BasicBigNum(1.0);
+      }
+      return count;
+    }
+    return BasicBigNum(n);
+  }
 };
 
-inline std::ostream &operator<<(std::ostream &os, const BigNum &bn) {
+template <typename Policy>
+std::ostream &operator<<(std::ostream &os, const BasicBigNum<Policy> &bn) {
   os << bn.to_string();
   return os;
 }
 
-inline std::istream &operator>>(std::istream &is, BigNum &bn) {
+template <typename Policy>
+std::istream &operator>>(std::istream &is, BasicBigNum<Policy> &bn) {
   std::string input;
   is >> input;
   bn.parseStr(input);
   return is;
 }
 
+using BigNum = BasicBigNum<StrictPolicy>;
+using FastBigNum = BasicBigNum<FastPolicy>;
+
 // Asserts
 static_assert(std::equality_comparable<BigNum>);
 static_assert(std::totally_ordered<BigNum>);
@@ -924,18 +1416,957 @@ static_assert(std::copyable<BigNum>);
 static_assert(std::default_initializable<BigNum>);
 static_assert(std::semiregular<BigNum>);
 static_assert(std::regular<BigNum>);
+static_assert(std::regular<FastBigNum>);
+
+/* Stable LSD radix sort by sort_key(), in linear time
+ * `proj` maps each element to the BasicBigNum to sort by. Bytes that are the
+ * same across all keys (usually most of the exponent) are skipped.
+ */
+template <typename T, typename Proj>
+void radix_sort(std::span<T> values, Proj proj, bool descending = false) {
+  struct Entry {
+    SortKey key;
+    std::size_t index;
+  };
+  constexpr unsigned KEY_BYTES = 16;
+
+  const std::size_t n = values.size();
+  std::vector<Entry> entries(n), scratch(n);
+  std::vector<std::array<std::size_t, 256>> counts(KEY_BYTES);
+  for (std::size_t i = 0; i < n; ++i) {
+    SortKey key = std::invoke(proj, values[i]).sort_key();
+    if (descending) {
+      key = {~key.hi, ~key.lo};
+    }
+    entries[i] = {key, i};
+    for (unsigned b = 0; b < KEY_BYTES; ++b) {
+      ++counts[b][key.byte(b)];
+    }
+  }
+
+  for (unsigned b = 0; b < KEY_BYTES; ++b) {
+    auto &count = counts[b];
+    if (n == 0 || count[entries[0].key.byte(b)] == n) {
+      continue;
+    }
+    std::size_t offset = 0;
+    for (auto &c : count) {
+      offset += std::exchange(c, offset);
+    }
+    for (const Entry &entry : entries) {
+      scratch[count[entry.key.byte(b)]++] = entry;
+    }
+    entries.swap(scratch);
+  }
+
+  // Apply the permutation
+  std::vector<T> sorted;
+  sorted.reserve(n);
+  for (const Entry &entry : entries) {
+    sorted.push_back(std::move(values[entry.index]));
+  }
+  std::move(sorted.begin(), sorted.end(), values.begin());
+}
+
+template <typename Policy>
+void radix_sort(std::span<BasicBigNum<Policy>> values,
+                bool descending = false) {
+  radix_sort(values, std::identity{}, descending);
+}
+
+/* Lazy expression templates
+ * lazy(x) wraps a number so that + - * / build an expression tree instead of
+ * evaluating each operator eagerly:
+ *   BigNum total = lazy(rate) * multiplier * dt + current;
+ * eval(), or converting to a BasicBigNum, walks the tree once over raw
+ * mantissa/exponent pairs and only normalizes the final result. Expressions
+ * with exponents past RAW_EXP_LIMIT, where the raw exponent sums could
+ * overflow, are evaluated eagerly instead. Operands are stored by value, so an
+ * expression may outlive them.
+ */
+namespace expr {
+static inline constexpr std::uint64_t RAW_EXP_LIMIT = 1ull << 56;
+
+// Unnormalized intermediate value: m * 10^e
+struct Raw {
+  double m;
+  std::int64_t e;
+};
+
+// 10^k for k <= 0, flushing to zero below the double range
+inline double pow10_neg(std::int64_t k) {
+  if (k < -Pow10TableOffset) {
+    return 0.0;
+  }
+  return Pow10::Pow10Table[k + Pow10TableOffset];
+}
+
+// Keeps raw mantissas well inside the double range on long chains
+inline Raw rebase(Raw r) {
+  if (std::abs(r.m) > 1e150) {
+    return {r.m * 1e-150, r.e + 150};
+  }
+  if (std::abs(r.m) < 1e-150 && r.m != 0) {
+    return {r.m * 1e150, r.e - 150};
+  }
+  return r;
+}
+
+struct Add {
+  static Raw apply(Raw a, Raw b) {
+    if (a.m == 0) {
+      return b;
+    }
+    if (b.m == 0) {
+      return a;
+    }
+    if (a.e < b.e) {
+      std::swap(a, b);
+    }
+    return {a.m + b.m * pow10_neg(b.e - a.e), a.e};
+  }
+  template <typename P>
+  static BasicBigNum<P> apply(const BasicBigNum<P> &a,
+                              const BasicBigNum<P> &b) {
+    return a + b;
+  }
+};
+struct Sub {
+  static Raw apply(Raw a, Raw b) { return Add::apply(a, {-b.m, b.e}); }
+  template <typename P>
+  static BasicBigNum<P> apply(const BasicBigNum<P> &a,
+                              const BasicBigNum<P> &b) {
+    return a - b;
+  }
+};
+struct Mul {
+  static Raw apply(Raw a, Raw b) { return rebase({a.m * b.m, a.e + b.e}); }
+  template <typename P>
+  static BasicBigNum<P> apply(const BasicBigNum<P> &a,
+                              const BasicBigNum<P> &b) {
+    return a * b;
+  }
+};
+struct Div {
+  static Raw apply(Raw a, Raw b) {
+    if (b.m == 0) {
+      return {std::numeric_limits<double>::quiet_NaN(), 0};
+    }
+    return rebase({a.m / b.m, a.e - b.e});
+  }
+  template <typename P>
+  static BasicBigNum<P> apply(const BasicBigNum<P> &a,
+                              const BasicBigNum<P> &b) {
+    return a / b;
+  }
+};
+
+// Base of every expression node. Derived must provide raw(), eager() and
+// ordinary() (whether raw() is safe to use).
+template <typename Policy, typename Derived> class Expr {
+  static BasicBigNum<Policy> finish(Raw r) {
+    if (r.m == 0 || !std::isfinite(r.m)) {
+      return BasicBigNum<Policy>(r.m);
+    }
+    if (r.e < 0) {
+      return BasicBigNum<Policy>(r.m * pow10_neg(r.e));
+    }
+    // Cancellation can leave |m| < 1 with a positive exponent
+    if (std::abs(r.m) < 1) {
+      std::int64_t shift = std::min<std::int64_t>(
+          {r.e, -Policy::floor_log10(std::abs(r.m)), Pow10TableOffset});
+      r.m *= Pow10::Pow10Table[shift + Pow10TableOffset];
+      r.e -= shift;
+    }
+    return BasicBigNum<Policy>(r.m, static_cast<std::uint64_t>(r.e));
+  }
+
+public:
+  using policy_type = Policy;
+
+  BasicBigNum<Policy> eval() const {
+    const Derived &self = static_cast<const Derived &>(*this);
+    if (!self.ordinary()) {
+      return self.eager();
+    }
+    return finish(self.raw());
+  }
+  operator BasicBigNum<Policy>() const { return eval(); }
+};
+
+template <typename Policy> class Leaf : public Expr<Policy, Leaf<Policy>> {
+  BasicBigNum<Policy> value;
+
+public:
+  explicit Leaf(const BasicBigNum<Policy> &v) : value(v) {}
+
+  bool ordinary() const {
+    return value.is_small() || value.e < RAW_EXP_LIMIT;
+  }
+  Raw raw() const {
+    if (value.is_small()) {
+      return {static_cast<double>(value.small()), 0};
+    }
+    return {value.m, static_cast<std::int64_t>(value.e)};
+  }
+  BasicBigNum<Policy> eager() const { return value; }
+};
+
+template <typename Op, typename L, typename R>
+class Binary : public Expr<typename L::policy_type, Binary<Op, L, R>> {
+  L lhs;
+  R rhs;
+
+public:
+  Binary(const L &l, const R &r) : lhs(l), rhs(r) {}
+
+  bool ordinary() const { return lhs.ordinary() && rhs.ordinary(); }
+  Raw raw() const { return Op::apply(lhs.raw(), rhs.raw()); }
+  BasicBigNum<typename L::policy_type> eager() const {
+    return Op::apply(lhs.eager(), rhs.eager());
+  }
+};
+
+template <typename T>
+concept Expression = requires { typename T::policy_type; } &&
+                     std::derived_from<T, Expr<typename T::policy_type, T>>;
+
+// Operands are expressions, numbers of the same policy, or plain arithmetic
+template <typename Policy, typename T> auto node(const T &x) {
+  if constexpr (Expression<T>) {
+    static_assert(std::same_as<typename T::policy_type, Policy>,
+                  "cannot mix normalization policies in an expression");
+    return x;
+  } else if constexpr (std::same_as<T, BasicBigNum<Policy>>) {
+    return Leaf<Policy>(x);
+  } else {
+    static_assert(std::is_arithmetic_v<T>, "unsupported expression operand");
+    return Leaf<Policy>(BasicBigNum<Policy>(static_cast<double>(x)));
+  }
+}
+
+template <typename Op, typename L, typename R>
+auto make(const L &l, const R &r) {
+  using Policy = typename std::conditional_t<Expression<L>, L, R>::policy_type;
+  using LN = decltype(node<Policy>(l));
+  using RN = decltype(node<Policy>(r));
+  return Binary<Op, LN, RN>(node<Policy>(l), node<Policy>(r));
+}
+
+template <typename L, typename R>
+  requires Expression<L> || Expression<R>
+auto operator+(const L &l, const R &r) {
+  return make<Add>(l, r);
+}
+template <typename L, typename R>
+  requires Expression<L> || Expression<R>
+auto operator-(const L &l, const R &r) {
+  return make<Sub>(l, r);
+}
+template <typename L, typename R>
+  requires Expression<L> || Expression<R>
+auto operator*(const L &l, const R &r) {
+  return make<Mul>(l, r);
+}
+template <typename L, typename R>
+  requires Expression<L> || Expression<R>
+auto operator/(const L &l, const R &r) {
+  return make<Div>(l, r);
+}
+template <Expression E> auto operator-(const E &x) { return make<Mul>(x, -1); }
+} // namespace expr
+
+// Starts a lazy expression (see BigNumber::expr)
+template <typename Policy>
+expr::Leaf<Policy> lazy(const BasicBigNum<Policy> &x) {
+  return expr::Leaf<Policy>(x);
+}
+
+/* Accumulator for many small increments into a large value
+ * BasicBigNum::operator+= drops an addend more than 14 orders of magnitude
+ * below the current value, and rounds away most digits of one just above
+ * that. The accumulator instead buffers addends below 10^unit, BUFFER_DIGITS
+ * orders of magnitude under the value, in a Kahan-compensated double, and
+ * folds whole units into the value with a single normalize once they add up.
+ */
+template <typename Policy> class BasicBigNumAccumulator {
+  using Num = BasicBigNum<Policy>;
+  static inline constexpr std::uint64_t BUFFER_DIGITS = 10;
+
+  Num total;
+  double pending = 0; // in units of 10^unit
+  double compensation = 0;
+  std::uint64_t unit = 0;
+
+  static std::uint64_t unit_of(const Num &n) {
+    if (n.is_small() || n.e <= BUFFER_DIGITS) {
+      return 0;
+    }
+    return n.e - BUFFER_DIGITS;
+  }
+
+  // 10^k, 0 below the double range
+  static double scale(std::int64_t k) {
+    return Pow10::get(static_cast<int>(std::max<std::int64_t>(
+                          k, -Pow10TableOffset - 1)))
+        .value_or(k < 0 ? 0.0 : std::numeric_limits<double>::infinity());
+  }
+
+  void buffer(double x) {
+    double y = x - compensation;
+    double t = pending + y;
+    compensation = (t - pending) - y;
+    pending = t;
+  }
+
+  // Rescales the buffer after the value's magnitude changed
+  void rebase() {
+    std::uint64_t new_unit = unit_of(total);
+    if (new_unit == unit) {
+      return;
+    }
+    double factor = scale(static_cast<std::int64_t>(unit) -
+                          static_cast<std::int64_t>(new_unit));
+    pending *= factor;
+    compensation *= factor;
+    unit = new_unit;
+  }
+
+  // Moves whole units from the buffer into the value
+  void flush_whole() {
+    while (std::abs(pending) >= 1) {
+      double whole = std::trunc(pending);
+      pending -= whole;
+      if (total.is_small()) {
+        total += Num(whole);
+      } else {
+        total.m += whole * scale(static_cast<std::int64_t>(unit) -
+                                 static_cast<std::int64_t>(total.e));
+        total.normalize();
+      }
+      rebase();
+    }
+  }
+
+public:
+  BasicBigNumAccumulator() = default;
+  explicit BasicBigNumAccumulator(const Num &initial)
+      : total(initial), unit(unit_of(initial)) {}
+
+  BasicBigNumAccumulator &operator+=(const Num &x) {
+    // Integer counts: nothing to lose
+    if (total.is_small() && x.is_small()) {
+      total += x;
+      rebase();
+      return *this;
+    }
+    if (total.is_nan() || total.is_inf() || x.is_nan() || x.is_inf()) {
+      total = total + x;
+      return *this;
+    }
+
+    // At least one unit: add directly
+    const Num b = x.big();
+    if (b.e > unit || (b.e == unit && std::abs(b.m) >= 1)) {
+      total += b;
+      rebase();
+      flush_whole();
+      return *this;
+    }
+
+    buffer(b.m * scale(static_cast<std::int64_t>(b.e) -
+                       static_cast<std::int64_t>(unit)));
+    flush_whole();
+    return *this;
+  }
+  BasicBigNumAccumulator &operator-=(const Num &x) {
+    return *this += x.negate();
+  }
+
+  // The accumulated value, including buffered fractions of a unit
+  Num value() const {
+    if (pending == 0) {
+      return total;
+    }
+    int k = std::max(Policy::floor_log10(std::abs(pending)),
+                     -static_cast<int>(std::min<std::uint64_t>(unit, 300)));
+    return total + Num(pending / *Pow10::get(k),
+                       static_cast<std::uint64_t>(static_cast<std::int64_t>(
+                           unit) + k));
+  }
+
+  // Folds everything buffered into the value and returns it
+  const Num &flush() {
+    total = value();
+    pending = 0;
+    compensation = 0;
+    unit = unit_of(total);
+    return total;
+  }
+};
+
+using BigNumAccumulator = BasicBigNumAccumulator<StrictPolicy>;
+using FastBigNumAccumulator = BasicBigNumAccumulator<FastPolicy>;
+
+// Allocator returning storage aligned to `Align` bytes, so that SIMD kernels
+// can operate on whole registers starting at element 0
+template <typename T, std::size_t Align> struct AlignedAllocator {
+  using value_type = T;
+  static_assert(Align >= alignof(T), "alignment must not be weaker than T's");
+
+  template <typename U> struct rebind {
+    using other = AlignedAllocator<U, Align>;
+  };
+
+  AlignedAllocator() = default;
+  template <typename U>
+  constexpr AlignedAllocator(const AlignedAllocator<U, Align> &) noexcept {}
+
+  [[nodiscard]] T *allocate(std::size_t n) {
+    return static_cast<T *>(
+        ::operator new(n * sizeof(T), std::align_val_t{Align}));
+  }
+  void deallocate(T *p, std::size_t) noexcept {
+    ::operator delete(p, std::align_val_t{Align});
+  }
+
+  template <typename U>
+  bool operator==(const AlignedAllocator<U, Align> &) const noexcept {
+    return true;
+  }
+};
+
+/* SIMD lane wrappers used by the BigNumVector kernels
+ * Each wrapper exposes the same small set of operations over `width` lanes of
+ * (double mantissa, uint64 exponent) so the kernels are only written once.
+ * Kernels only take the vector path for "ordinary" lanes: finite mantissas
+ * and exponents below ORDINARY_EXP_LIMIT, so that exponent sums never wrap and
+ * signed 64-bit compares are valid. Anything else falls back to scalar BigNum
+ * code for that block.
+ */
+namespace simd {
+static inline constexpr std::uint64_t ORDINARY_EXP_LIMIT = 1ull << 62;
+
+#if defined(__AVX2__)
+struct Avx2 {
+  static constexpr std::size_t width = 4;
+  using md = __m256d;
+  using mi = __m256i;
+
+  static md load(const double *p) { return _mm256_loadu_pd(p); }
+  static mi load(const std::uint64_t *p) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+  }
+  static void store(double *p, md v) { _mm256_storeu_pd(p, v); }
+  static void store(std::uint64_t *p, mi v) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), v);
+  }
+  static md set1(double v) { return _mm256_set1_pd(v); }
+  static mi set1(std::uint64_t v) {
+    return _mm256_set1_epi64x(static_cast<long long>(v));
+  }
+
+  static md add(md a, md b) { return _mm256_add_pd(a, b); }
+  static md sub(md a, md b) { return _mm256_sub_pd(a, b); }
+  static md mul(md a, md b) { return _mm256_mul_pd(a, b); }
+  static md div(md a, md b) { return _mm256_div_pd(a, b); }
+  static md floor(md a) { return _mm256_floor_pd(a); }
+  static md trunc(md a) {
+    return _mm256_round_pd(a, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+  }
+  static md abs(md a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+  static md sign(md a) { return _mm256_and_pd(_mm256_set1_pd(-0.0), a); }
+
+  static md eq(md a, md b) { return _mm256_cmp_pd(a, b, _CMP_EQ_OQ); }
+  static md lt(md a, md b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+  static md ge(md a, md b) { return _mm256_cmp_pd(a, b, _CMP_GE_OQ); }
+  static md gt(md a, md b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+  static md and_(md a, md b) { return _mm256_and_pd(a, b); }
+  static md or_(md a, md b) { return _mm256_or_pd(a, b); }
+  static md andnot(md a, md b) { return _mm256_andnot_pd(a, b); }
+  static md select(md mask, md t, md f) { return _mm256_blendv_pd(f, t, mask); }
+  static int movemask(md mask) { return _mm256_movemask_pd(mask); }
+
+  static mi add(mi a, mi b) { return _mm256_add_epi64(a, b); }
+  static mi sub(mi a, mi b) { return _mm256_sub_epi64(a, b); }
+  static mi srl(mi a, int n) { return _mm256_srli_epi64(a, n); }
+  static mi and_(mi a, mi b) { return _mm256_and_si256(a, b); }
+  static md eq(mi a, mi b) {
+    return _mm256_castsi256_pd(_mm256_cmpeq_epi64(a, b));
+  }
+  // Signed compare, valid for ordinary exponents
+  static md gt(mi a, mi b) {
+    return _mm256_castsi256_pd(_mm256_cmpgt_epi64(a, b));
+  }
+  static mi select(md mask, mi t, mi f) {
+    return _mm256_castpd_si256(_mm256_blendv_pd(
+        _mm256_castsi256_pd(f), _mm256_castsi256_pd(t), mask));
+  }
+
+  static mi as_int(md a) { return _mm256_castpd_si256(a); }
+  static md as_double(mi a) { return _mm256_castsi256_pd(a); }
+  static md gather(const double *table, mi idx) {
+    return _mm256_i64gather_pd(table, idx, 8);
+  }
+};
+#endif // __AVX2__
+
+#if defined(__SSE4_2__)
+struct Sse4 {
+  static constexpr std::size_t width = 2;
+  using md = __m128d;
+  using mi = __m128i;
+
+  static md load(const double *p) { return _mm_loadu_pd(p); }
+  static mi load(const std::uint64_t *p) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+  }
+  static void store(double *p, md v) { _mm_storeu_pd(p, v); }
+  static void store(std::uint64_t *p, mi v) {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(p), v);
+  }
+  static md set1(double v) { return _mm_set1_pd(v); }
+  static mi set1(std::uint64_t v) {
+    return _mm_set1_epi64x(static_cast<long long>(v));
+  }
+
+  static md add(md a, md b) { return _mm_add_pd(a, b); }
+  static md sub(md a, md b) { return _mm_sub_pd(a, b); }
+  static md mul(md a, md b) { return _mm_mul_pd(a, b); }
+  static md div(md a, md b) { return _mm_div_pd(a, b); }
+  static md floor(md a) { return _mm_floor_pd(a); }
+  static md trunc(md a) {
+    return _mm_round_pd(a, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+  }
+  static md abs(md a) { return _mm_andnot_pd(_mm_set1_pd(-0.0), a); }
+  static md sign(md a) { return _mm_and_pd(_mm_set1_pd(-0.0), a); }
+
+  static md eq(md a, md b) { return _mm_cmpeq_pd(a, b); }
+  static md lt(md a, md b) { return _mm_cmplt_pd(a, b); }
+  static md ge(md a, md b) { return _mm_cmpge_pd(a, b); }
+  static md gt(md a, md b) { return _mm_cmpgt_pd(a, b); }
+  static md and_(md a, md b) { return _mm_and_pd(a, b); }
+  static md or_(md a, md b) { return _mm_or_pd(a, b); }
+  static md andnot(md a, md b) { return _mm_andnot_pd(a, b); }
+  static md select(md mask, md t, md f) { return _mm_blendv_pd(f, t, mask); }
+  static int movemask(md mask) { return _mm_movemask_pd(mask); }
+
+  static mi add(mi a, mi b) { return _mm_add_epi64(a, b); }
+  static mi sub(mi a, mi b) { return _mm_sub_epi64(a, b); }
+  static mi srl(mi a, int n) { return _mm_srli_epi64(a, n); }
+  static mi and_(mi a, mi b) { return _mm_and_si128(a, b); }
+  static md eq(mi a, mi b) { return _mm_castsi128_pd(_mm_cmpeq_epi64(a, b)); }
+  // Signed compare, valid for ordinary exponents
+  static md gt(mi a, mi b) { return _mm_castsi128_pd(_mm_cmpgt_epi64(a, b)); }
+  static mi select(md mask, mi t, mi f) {
+    return _mm_castpd_si128(
+        _mm_blendv_pd(_mm_castsi128_pd(f), _mm_castsi128_pd(t), mask));
+  }
+
+  static mi as_int(md a) { return _mm_castpd_si128(a); }
+  static md as_double(mi a) { return _mm_castsi128_pd(a); }
+  // No gather instruction before AVX2
+  static md gather(const double *table, mi idx) {
+    return _mm_set_pd(table[_mm_extract_epi64(idx, 1)],
+                      table[_mm_cvtsi128_si64(idx)]);
+  }
+};
+#endif // __SSE4_2__
+
+#if defined(__AVX2__)
+using Native = Avx2;
+#define BIGNUM_SIMD 1
+#elif defined(__SSE4_2__)
+using Native = Sse4;
+#define BIGNUM_SIMD 1
+#endif
+
+#ifdef BIGNUM_SIMD
+template <typename V> struct Kernels {
+  using md = typename V::md;
+  using mi = typename V::mi;
+
+  // Bit patterns for converting small integers to/from double without
+  // AVX-512 conversion instructions
+  static constexpr std::uint64_t MAGIC_U = 0x4330000000000000ull; // 2^52
+  static constexpr std::uint64_t MAGIC_S = 0x4338000000000000ull; // 1.5*2^52
+
+  // Non-negative integer < 2^52 to double
+  static md to_double(mi v) {
+    return V::sub(V::as_double(V::add(v, V::set1(MAGIC_U))),
+                  V::set1(std::bit_cast<double>(MAGIC_U)));
+  }
+  // Integral double in [-2^51, 2^51] to integer
+  static mi to_int(md v) {
+    return V::sub(
+        V::as_int(V::add(v, V::set1(std::bit_cast<double>(MAGIC_S)))),
+        V::set1(MAGIC_S));
+  }
+
+  static md round_half_away(md v) {
+    md t = V::trunc(v);
+    md frac = V::abs(V::sub(v, t));
+    md one = V::or_(V::set1(1.0), V::sign(v));
+    return V::select(V::ge(frac, V::set1(0.5)), V::add(t, one), t);
+  }
+
+  // True if every lane holds a finite mantissa and an ordinary exponent
+  static bool ordinary(md m, mi e) {
+    md finite =
+        V::lt(V::abs(m), V::set1(std::numeric_limits<double>::infinity()));
+    md small_e = V::eq(V::srl(e, std::countr_zero(ORDINARY_EXP_LIMIT)),
+                       V::set1(std::uint64_t{0}));
+    return V::movemask(V::and_(finite, small_e)) == (1 << V::width) - 1;
+  }
+
+  // Vectorized BigNum::normalize() for ordinary lanes
+  static void normalize(md &m, mi &e) {
+    const double *table = Pow10::Pow10Table.data();
+    const mi offset = V::set1(static_cast<std::uint64_t>(Pow10TableOffset));
+    const md zero_d = V::set1(0.0);
+    const mi zero_i = V::set1(std::uint64_t{0});
+
+    md a = V::abs(m);
+    md is_zero = V::eq(m, zero_d);
+    md e_zero = V::eq(e, zero_i);
+    // |m| < 1 with e == 0 is left untouched, just like the scalar version
+    md keep = V::or_(is_zero, V::and_(V::lt(a, V::set1(1.0)), e_zero));
+    // Lowest shift: mantissas below 1 move down by at most e
+    const mi limit = V::set1(static_cast<std::uint64_t>(Pow10TableOffset));
+    md min_n = V::sub(zero_d, to_double(V::select(V::gt(e, limit), limit, e)));
+
+    // floor(log10(|m|)) estimated from the binary exponent, biased low so a
+    // single upward correction against the power table is enough
+    mi biased =
+        V::and_(V::srl(V::as_int(a), 52), V::set1(std::uint64_t{0x7ff}));
+    md bexp = V::sub(to_double(biased), V::set1(1023.0));
+    md n = V::floor(V::sub(V::mul(bexp, V::set1(0.30102999566398120)),
+                           V::set1(1e-9)));
+    n = V::select(V::gt(n, V::set1(-double(Pow10TableOffset))), n,
+                  V::set1(-double(Pow10TableOffset)));
+    md next = V::gather(table, V::add(to_int(V::add(n, V::set1(1.0))), offset));
+    n = V::select(V::ge(a, next), V::add(n, V::set1(1.0)), n);
+    n = V::select(V::gt(n, min_n), n, min_n);
+
+    mi n_i = to_int(n);
+    md scaled = V::div(m, V::gather(table, V::add(n_i, offset)));
+    mi shifted = V::add(e, n_i); // Wraps correctly for negative n
+
+    // Disregard fractional part if exponent is under the mantissa's precision
+    constexpr std::uint64_t PRECISION =
+        std::numeric_limits<double>::max_digits10;
+    md rounds = V::gt(V::set1(PRECISION), shifted);
+    mi p_idx = V::select(rounds, shifted, zero_i);
+    md p = V::gather(table, V::add(p_idx, offset));
+    md rounded = V::div(round_half_away(V::mul(scaled, p)), p);
+    scaled = V::select(rounds, rounded, scaled);
+    // Rounding may carry into a new digit: 9.99999999 -> 10
+    md carry = V::ge(V::abs(scaled), V::set1(10.0));
+    scaled = V::select(carry, V::div(scaled, V::set1(10.0)), scaled);
+    shifted = V::select(carry, V::add(shifted, V::set1(std::uint64_t{1})),
+                        shifted);
+
+    m = V::select(keep, m, scaled);
+    e = V::select(keep, V::select(is_zero, zero_i, e), shifted);
+  }
+
+  // (ma, ea) + (mb, eb), mirroring BigNum::add()
+  static void add(md &ma, mi &ea, md mb, mi eb) {
+    const double *table = Pow10::Pow10Table.data();
+    const mi offset = V::set1(static_cast<std::uint64_t>(Pow10TableOffset));
+
+    md a_hi = V::gt(ea, eb);
+    mi delta = V::select(a_hi, V::sub(ea, eb), V::sub(eb, ea));
+    md far = V::gt(delta, V::set1(std::uint64_t{14}));
+    delta = V::select(far, V::set1(std::uint64_t{0}), delta);
+
+    md m_hi = V::select(a_hi, ma, mb);
+    md m_lo = V::select(a_hi, mb, ma);
+    mi e_hi = V::select(a_hi, ea, eb);
+    mi e_lo = V::select(a_hi, eb, ea);
+
+    md scale = V::gather(table, V::add(delta, offset));
+    md sum = V::add(V::mul(m_hi, scale), m_lo);
+    ma = V::select(far, m_hi, sum);
+    ea = V::select(far, e_hi, e_lo);
+    normalize(ma, ea);
+  }
+
+  static void mul(md &ma, mi &ea, md mb, mi eb) {
+    ma = V::mul(ma, mb);
+    ea = V::add(ea, eb);
+    normalize(ma, ea);
+  }
+
+  // Returns lane masks for a > b and a == b, mirroring BigNum::operator<=>
+  static void compare(md ma, mi ea, md mb, mi eb, md &greater, md &equal) {
+    const md zero_d = V::set1(0.0);
+    md a_pos = V::ge(ma, zero_d);
+    md b_pos = V::ge(mb, zero_d);
+    md e_gt = V::gt(ea, eb);
+    md e_lt = V::gt(eb, ea);
+    md e_eq = V::eq(ea, eb);
+
+    md pos_gt = V::or_(e_gt, V::and_(e_eq, V::gt(ma, mb)));
+    md neg_gt = V::or_(e_lt, V::and_(e_eq, V::gt(ma, mb)));
+    md all = V::eq(zero_d, zero_d);
+
+    greater = V::select(a_pos, V::select(b_pos, pos_gt, all),
+                        V::andnot(b_pos, neg_gt));
+    equal = V::and_(V::eq(ma, mb), e_eq);
+  }
+};
+#endif // BIGNUM_SIMD
+} // namespace simd
+
+/* BigNumVector: structure-of-arrays storage for many BigNums
+ * Mantissas and exponents live in separate aligned arrays so whole spans can
+ * be updated with SIMD kernels (AVX2 or SSE4.2, picked at compile time) instead
+ * of one scalar operation and normalization per element. Blocks containing
+ * non-finite values or huge exponents are delegated to the scalar
+ * implementation.
+ *
+ * Lanes hold the mantissa/exponent form: small integer values are stored
+ * through big(), so integer amounts take the vector path like any other.
+ * Results compare equal to the scalar BigNum operations, but integers come
+ * back in mantissa/exponent form rather than as small values, and all-integer
+ * spans run faster as scalar small-value arithmetic (see bignum_bench).
+ */
+class BigNumVector {
+  using man_t = BigNum::man_t;
+  using exp_t = BigNum::exp_t;
+  static_assert(sizeof(exp_t) == sizeof(std::uint64_t),
+                "SIMD kernels assume 64-bit exponents");
+
+public:
+  static inline constexpr std::size_t ALIGNMENT = 32;
+  template <typename T>
+  using AlignedVector = std::vector<T, AlignedAllocator<T, ALIGNMENT>>;
+
+private:
+  AlignedVector<man_t> ms;
+  AlignedVector<std::uint64_t> es;
+
+  BigNum load(std::size_t i) const { return BigNum(ms[i], es[i], false); }
+  // Lanes always hold the mantissa/exponent form
+  void store(std::size_t i, const BigNum &b) {
+    const BigNum n = b.big();
+    ms[i] = n.m;
+    es[i] = n.e;
+  }
+
+  // Apply `vec` to full SIMD blocks of ordinary lanes, `scalar` to the rest
+  template <typename Vec, typename Scalar>
+  void for_blocks([[maybe_unused]] Vec &&vec, Scalar &&scalar) {
+    std::size_t i = 0;
+#ifdef BIGNUM_SIMD
+    constexpr std::size_t W = simd::Native::width;
+    for (; i + W <= ms.size(); i += W) {
+      if (!vec(i)) {
+        for (std::size_t j = i; j < i + W; ++j) {
+          scalar(j);
+        }
+      }
+    }
+#endif
+    for (; i < ms.size(); ++i) {
+      scalar(i);
+    }
+  }
+
+public:
+  BigNumVector() = default;
+  explicit BigNumVector(std::size_t n) : ms(n, 0.0), es(n, 0) {}
+  BigNumVector(std::initializer_list<BigNum> values) {
+    reserve(values.size());
+    for (const auto &v : values) {
+      push_back(v);
+    }
+  }
+
+  std::size_t size() const { return ms.size(); }
+  bool empty() const { return ms.empty(); }
+  void reserve(std::size_t n) {
+    ms.reserve(n);
+    es.reserve(n);
+  }
+  void resize(std::size_t n) {
+    ms.resize(n, 0.0);
+    es.resize(n, 0);
+  }
+  void clear() {
+    ms.clear();
+    es.clear();
+  }
+  void push_back(const BigNum &b) {
+    const BigNum n = b.big();
+    ms.push_back(n.m);
+    es.push_back(n.e);
+  }
+
+  BigNum get(std::size_t i) const { return load(i); }
+  BigNum operator[](std::size_t i) const { return load(i); }
+  void set(std::size_t i, const BigNum &b) { store(i, b); }
+
+  std::span<const man_t> mantissas() const { return ms; }
+  std::span<const std::uint64_t> exponents() const { return es; }
+
+  // this[i] = normalize(this[i])
+  void normalize() {
+    for_blocks(
+        [&]([[maybe_unused]] std::size_t i) {
+#ifdef BIGNUM_SIMD
+          using V = simd::Native;
+          auto m = V::load(&ms[i]);
+          auto e = V::load(&es[i]);
+          if (!simd::Kernels<V>::ordinary(m, e))
+            return false;
+          simd::Kernels<V>::normalize(m, e);
+          V::store(&ms[i], m);
+          V::store(&es[i], e);
+#endif
+          return true;
+        },
+        [&](std::size_t i) {
+          BigNum b = load(i);
+          b.normalize();
+          store(i, b);
+        });
+  }
+
+  // this[i] += b[i]
+  void add(const BigNumVector &b) {
+    assert(b.size() == size() && "BigNumVector sizes must match");
+    for_blocks(
+        [&]([[maybe_unused]] std::size_t i) {
+#ifdef BIGNUM_SIMD
+          using V = simd::Native;
+          using K = simd::Kernels<V>;
+          auto ma = V::load(&ms[i]);
+          auto ea = V::load(&es[i]);
+          auto mb = V::load(&b.ms[i]);
+          auto eb = V::load(&b.es[i]);
+          if (!K::ordinary(ma, ea) || !K::ordinary(mb, eb))
+            return false;
+          K::add(ma, ea, mb, eb);
+          V::store(&ms[i], ma);
+          V::store(&es[i], ea);
+#endif
+          return true;
+        },
+        [&](std::size_t i) { store(i, load(i).add(b.load(i))); });
+  }
+
+  // this[i] *= b[i]
+  void mul(const BigNumVector &b) {
+    assert(b.size() == size() && "BigNumVector sizes must match");
+    for_blocks(
+        [&]([[maybe_unused]] std::size_t i) {
+#ifdef BIGNUM_SIMD
+          using V = simd::Native;
+          using K = simd::Kernels<V>;
+          auto ma = V::load(&ms[i]);
+          auto ea = V::load(&es[i]);
+          auto mb = V::load(&b.ms[i]);
+          auto eb = V::load(&b.es[i]);
+          if (!K::ordinary(ma, ea) || !K::ordinary(mb, eb))
+            return false;
+          K::mul(ma, ea, mb, eb);
+          V::store(&ms[i], ma);
+          V::store(&es[i], ea);
+#endif
+          return true;
+        },
+        [&](std::size_t i) { store(i, load(i).mul(b.load(i))); });
+  }
+
+  // this[i] += a[i] * b[i], e.g. one production pass: counts.fma(rates, dt)
+  void fma(const BigNumVector &a, const BigNumVector &b) {
+    assert(a.size() == size() && b.size() == size() &&
+           "BigNumVector sizes must match");
+    for_blocks(
+        [&]([[maybe_unused]] std::size_t i) {
+#ifdef BIGNUM_SIMD
+          using V = simd::Native;
+          using K = simd::Kernels<V>;
+          auto mc = V::load(&ms[i]);
+          auto ec = V::load(&es[i]);
+          auto ma = V::load(&a.ms[i]);
+          auto ea = V::load(&a.es[i]);
+          auto mb = V::load(&b.ms[i]);
+          auto eb = V::load(&b.es[i]);
+          if (!K::ordinary(mc, ec) || !K::ordinary(ma, ea) ||
+              !K::ordinary(mb, eb))
+            return false;
+          K::mul(ma, ea, mb, eb);
+          K::add(mc, ec, ma, ea);
+          V::store(&ms[i], mc);
+          V::store(&es[i], ec);
+#endif
+          return true;
+        },
+        [&](std::size_t i) {
+          store(i, load(i).add(a.load(i).mul(b.load(i))));
+        });
+  }
+
+  // out[i] = this[i] <=> b[i]
+  void compare(const BigNumVector &b,
+               std::span<std::partial_ordering> out) const {
+    assert(b.size() == size() && out.size() >= size() &&
+           "BigNumVector sizes must match");
+    std::size_t i = 0;
+#ifdef BIGNUM_SIMD
+    using V = simd::Native;
+    using K = simd::Kernels<V>;
+    constexpr std::size_t W = V::width;
+    for (; i + W <= size(); i += W) {
+      auto ma = V::load(&ms[i]);
+      auto ea = V::load(&es[i]);
+      auto mb = V::load(&b.ms[i]);
+      auto eb = V::load(&b.es[i]);
+      if (!K::ordinary(ma, ea) || !K::ordinary(mb, eb)) {
+        for (std::size_t j = i; j < i + W; ++j) {
+          out[j] = load(j) <=> b.load(j);
+        }
+        continue;
+      }
+      typename V::md greater, equal;
+      K::compare(ma, ea, mb, eb, greater, equal);
+      int gt_bits = V::movemask(greater);
+      int eq_bits = V::movemask(equal);
+      for (std::size_t j = 0; j < W; ++j) {
+        out[i + j] = (eq_bits >> j) & 1   ? std::partial_ordering::equivalent
+                     : (gt_bits >> j) & 1 ? std::partial_ordering::greater
+                                          : std::partial_ordering::less;
+      }
+    }
+#endif
+    for (; i < size(); ++i) {
+      out[i] = load(i) <=> b.load(i);
+    }
+  }
+};
 
 } // namespace BigNumber
 
 // Expose BigNum to the global namespace
 using BigNumber::BigNum;
+using BigNumber::BigNumAccumulator;
+using BigNumber::BigNumVector;
+using BigNumber::FastBigNum;
+using BigNumber::FastBigNumAccumulator;
+using BigNumber::lazy;
 
 // std::format specialization
-template <> struct std::formatter<BigNum> {
-  int precision = BigNumber::DefaultBigNumContext.print_precision;
+template <typename Policy>
+struct std::formatter<BigNumber::BasicBigNum<Policy>> {
+  // -1: use DefaultBigNumContext.print_precision at format time
+  int precision = -1;
+  BigNumber::Notation notation = BigNumber::Notation::Standard;
 
   // 2. Parse the format specifier
-  // Example: {:v} for verbose, {} for default
+  // Example: {:5} for precision, {:p} for pretty, {} for default
   constexpr auto parse(format_parse_context &ctx) {
     auto it = ctx.begin();
 
@@ -947,11 +2378,29 @@ template <> struct std::formatter<BigNum> {
         ++it;
       }
     }
+    if (it != ctx.end() && *it == 'p') {
+      notation = BigNumber::Notation::Pretty;
+      ++it;
+    }
     return it;
   }
 
   // 3. Format the object
-  auto format(const BigNum &num, format_context &ctx) const {
-    return format_to(ctx.out(), "{}", num.to_string(precision));
+  auto format(const BigNumber::BasicBigNum<Policy> &num,
+              format_context &ctx) const {
+    unsigned int precision =
+        this->precision < 0
+            ? BigNumber::DefaultBigNumContext.print_precision
+            : static_cast<unsigned int>(this->precision);
+    std::array<char, 64> buf;
+    auto [end, ec] =
+        num.format_to(buf.data(), buf.data() + buf.size(), precision, notation);
+    if (ec != std::errc()) {
+      return std::format_to(ctx.out(), "{}",
+                            notation == BigNumber::Notation::Pretty
+                                ? num.to_pretty_string(precision)
+                                : num.to_string(precision));
+    }
+    return std::copy(buf.data(), end, ctx.out());
   }
 };
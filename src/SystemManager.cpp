@@ -1,5 +1,7 @@
 #include <thread>
 
+#include "./resources/SaveData.hpp"
+#include "./systems/Autosave.hpp"
 #include "./systems/ScreenManager.hpp"
 #include "Logger.hpp"
 #include "SystemManager.hpp"
@@ -10,6 +12,9 @@ void SystemManager::init() {
 
   ScreenManager::init();
   SystemManager::instance().registerSystem(&ScreenManager::instance());
+
+  Autosave::init();
+  SystemManager::instance().registerSystem(&Autosave::instance());
 }
 
 void System::onInit() {};
@@ -32,6 +37,8 @@ void SystemManager::onTick() {
   for (const auto &system : systems) {
     system->onTick();
   }
+  // Let readers on other threads see this tick's state
+  Save::SaveData::instance().publishViewed();
   auto end = Clock::now();
 
   // Calculate time to sleep
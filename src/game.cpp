@@ -1,17 +1,23 @@
 #include <atomic>
 #include <chrono>
 #include <cstdlib>
+#include <ctime>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <optional>
 #include <print>
 #include <string>
+#include <system_error>
 #include <thread>
 
 #include <curses.h>
 
 #include "./SystemManager.hpp"
+#include "./resources/Recipes.hpp"
 #include "./resources/SaveData.hpp"
+#include "./resources/SaveSlots.hpp"
+#include "./systems/Autosave.hpp"
 #include "Logger.hpp"
 #include "game.hpp"
 
@@ -21,6 +27,14 @@ using nlohmann::json;
 using Clock = std::chrono::steady_clock;
 using namespace std::chrono_literals;
 using Save::SaveData;
+using Save::SaveSlots;
+// Saves are binary unless the file name ends in .json, and compressed if it
+// ends in .lz4
+static constexpr auto DEFAULT_SAVEFILE = "save.dat";
+static constexpr auto LEGACY_SAVEFILE = "save.json";
+static constexpr auto DEFAULT_DATADIR = "./data/";
+static constexpr auto USAGE = "[--save <savefile> | --slot <name>] "
+                              "[--list-slots] [--data <dir>] [--journal]";
 std::atomic_bool Game::exit = false;
 namespace detail {
 std::ofstream logstream;
@@ -93,7 +107,15 @@ void run() {
   Logger::println("Exiting...");
 }
 
-void init(fs::path savepath) {
+void init(fs::path savepath, fs::path datadir, bool journal) {
+
+  // Load game content, before curses so errors show in the terminal
+  if (!Recipes::instance().load(datadir)) {
+    std::println(stderr,
+                 "Could not load game data from {}, see logs/latest.log",
+                 datadir.string());
+    std::exit(EXIT_FAILURE);
+  }
 
   // Initialize curses
   Logger::println("Initializing curses...");
@@ -102,17 +124,54 @@ void init(fs::path savepath) {
   // Initialize systems
   SystemManager::init();
 
-  // Load game data
-  if (fs::is_regular_file(savepath)) {
-    std::ifstream file(savepath);
-    SaveData::instance().deserialize(file);
+  // Load game data, from the old JSON default if there's no save yet
+  fs::path loadpath = savepath;
+  if (!fs::exists(loadpath) && savepath.filename() == DEFAULT_SAVEFILE) {
+    loadpath.replace_filename(LEGACY_SAVEFILE);
+  }
+  if (fs::is_regular_file(loadpath)) {
+    std::ifstream file(loadpath, std::ios::binary);
+    if (!SaveData::instance().deserialize(file)) {
+      // Don't let autosave overwrite a save that failed to load
+      endwin();
+      std::println(stderr, "Could not load {}, see logs/latest.log",
+                   loadpath.string());
+      std::exit(EXIT_FAILURE);
+    }
+  }
+  SaveSlots::instance().select(savepath);
+  Autosave::instance().setSavePath(savepath);
+
+  // Replay a log left by a journal session whatever this one does: a save
+  // made without it would keep the log's old sequence number, and a later
+  // replay would apply its records on top of newer state
+  fs::path journalpath = savepath;
+  journalpath += ".journal";
+  bool replayed = false;
+  if (fs::is_regular_file(journalpath)) {
+    std::ifstream file(journalpath, std::ios::binary);
+    Logger::println("Replayed {} journal records",
+                    SaveData::instance().replayJournal(file));
+    replayed = true;
+  }
+  if (journal) {
+    SaveData::instance().enableJournal();
+    Autosave::instance().setJournalPath(journalpath);
+  }
+  // Fold the replayed log (and any torn tail) into a fresh save. Journal
+  // mode empties the log itself; otherwise nothing appends to it again.
+  if (replayed && Autosave::instance().saveNow() && !journal) {
+    std::error_code ec;
+    if (!fs::remove(journalpath, ec) && ec) {
+      Logger::println("Error: Could not remove {}: {}", journalpath.string(),
+                      ec.message());
+    }
   }
 }
 
-void cleanup(fs::path savepath) {
+void cleanup() {
   // Save game data
-  std::ofstream file(savepath);
-  SaveData::instance().serialize(file);
+  Autosave::instance().saveNow();
 }
 
 void ensure_directory(fs::path directory) {
@@ -131,8 +190,44 @@ void ensure_directory(fs::path directory) {
   }
 }
 
+// Prints the save slots from the index, without loading any save
+void list_slots() {
+  auto slots = SaveSlots::instance().list();
+  if (slots.empty()) {
+    std::println("No saves yet");
+    return;
+  }
+  std::println("{:<16} {:<16} {:>9} {:>10} {:>12} {:>6} {:>9}", "Slot",
+               "Last played", "Playtime", "Size", "Bills", "Items",
+               "Upgrades");
+  for (const auto &slot : slots) {
+    std::time_t time = static_cast<std::time_t>(slot.lastPlayed);
+    char played[32] = "?";
+    if (const std::tm *local = std::localtime(&time)) {
+      (void)std::strftime(played, sizeof(played), "%Y-%m-%d %H:%M", local);
+    }
+    string playtime = std::format("{}h {:02}m", slot.playtime / 3600,
+                                  slot.playtime / 60 % 60);
+    string size = std::format("{:.1f} KiB", static_cast<double>(slot.size) /
+                                                1024.0);
+    // BigNum's formatter has no width, so format the stats first
+    string bills = "-", items = "-", upgrades = "-";
+    if (slot.stats) {
+      bills = std::format("{:p}", slot.stats->bills);
+      items = std::format("{}", slot.stats->items);
+      upgrades = std::format("{:p}", slot.stats->upgrades);
+    }
+    std::println("{:<16} {:<16} {:>9} {:>10} {:>12} {:>6} {:>9}", slot.name,
+                 played, playtime, size, bills, items, upgrades);
+  }
+}
+
 int main(int argc, char *argv[]) {
-  string savefile = "save.json";
+  string savefile = DEFAULT_SAVEFILE;
+  std::optional<string> slot;
+  string datadir = DEFAULT_DATADIR;
+  bool listSlots = false;
+  bool journal = false;
 
   // Loop through the command-line arguments starting from the first
   // user-provided argument (at index 1), since argv[0] is the program name.
@@ -151,14 +246,39 @@ int main(int argc, char *argv[]) {
       } else {
         // If "--save" is the last argument, there's a missing value.
         std::cerr << "Error: --save option requires an argument." << std::endl;
-        std::cerr << "Usage: " << argv[0] << " [--save <savefile>]"
-                  << std::endl;
+        std::cerr << "Usage: " << argv[0] << " " << USAGE << std::endl;
+        return EXIT_FAILURE;
+      }
+    } else if (arg == "--slot") {
+      // Like --save, but by slot name (see SaveSlots)
+      if (i + 1 < argc && fs::path(argv[i + 1]).has_filename() &&
+          !fs::path(argv[i + 1]).has_parent_path()) {
+        slot = argv[i + 1];
+        i++;
+      } else {
+        std::cerr << "Error: --slot option requires a name." << std::endl;
+        std::cerr << "Usage: " << argv[0] << " " << USAGE << std::endl;
+        return EXIT_FAILURE;
+      }
+    } else if (arg == "--data") {
+      // Directory of the *.json content files (recipes)
+      if (i + 1 < argc) {
+        datadir = argv[i + 1];
+        i++;
+      } else {
+        std::cerr << "Error: --data option requires an argument." << std::endl;
+        std::cerr << "Usage: " << argv[0] << " " << USAGE << std::endl;
         return EXIT_FAILURE;
       }
+    } else if (arg == "--list-slots") {
+      listSlots = true;
+    } else if (arg == "--journal") {
+      // Log every change next to the save instead of rewriting it
+      journal = true;
     } else {
       // If the argument is not "--save", it's an unrecognized option.
       std::cerr << "Error: Unrecognized option '" << arg << "'" << std::endl;
-      std::cerr << "Usage: " << argv[0] << " [--save <savefile>]" << std::endl;
+      std::cerr << "Usage: " << argv[0] << " " << USAGE << std::endl;
       return EXIT_FAILURE;
     }
   }
@@ -167,13 +287,25 @@ int main(int argc, char *argv[]) {
   ensure_directory(logdir);
   fs::path savedir("./saves/");
   ensure_directory(savedir);
-  fs::path savepath = savedir / savefile;
   detail::logstream.open("./logs/latest.log");
 
+  SaveSlots::instance().open(savedir);
+  if (listSlots) {
+    list_slots();
+    detail::logstream.close();
+    return EXIT_SUCCESS;
+  }
+  if (slot) {
+    // An existing slot keeps its file (and format); new slots are binary
+    auto existing = SaveSlots::instance().find(*slot);
+    savefile = existing ? existing->file : *slot + ".dat";
+  }
+  fs::path savepath = savedir / savefile;
+
   // Setup
-  init(savepath);
+  init(savepath, datadir, journal);
   run();
-  cleanup(savepath);
+  cleanup();
 
   detail::logstream.close();
   return EXIT_SUCCESS;
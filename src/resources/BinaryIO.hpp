@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Little-endian primitives for binary files, independent of the host's byte
+// order
+namespace BinaryIO {
+
+class Writer {
+private:
+  std::string &out;
+
+  template <typename T> void put(T value) {
+    for (std::size_t i = 0; i < sizeof(T); ++i) {
+      out.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+    }
+  }
+
+public:
+  explicit Writer(std::string &out) : out{out} {}
+
+  void u8(std::uint8_t value) { put(value); }
+  void u16(std::uint16_t value) { put(value); }
+  void u32(std::uint32_t value) { put(value); }
+  void u64(std::uint64_t value) { put(value); }
+  void bytes(std::string_view data) { out.append(data); }
+
+  // Length-prefixed string
+  void str(std::string_view data) {
+    u32(static_cast<std::uint32_t>(data.size()));
+    bytes(data);
+  }
+
+  std::size_t size() const { return out.size(); }
+};
+
+// Reads from a buffer without throwing. Reading past the end returns zeroes
+// and sets failed(), so callers can check once after a batch of reads.
+class Reader {
+private:
+  const char *pos;
+  const char *end;
+  bool error = false;
+
+  template <typename T> T get() {
+    if (static_cast<std::size_t>(end - pos) < sizeof(T)) {
+      error = true;
+      pos = end;
+      return 0;
+    }
+    T value = 0;
+    for (std::size_t i = 0; i < sizeof(T); ++i) {
+      value |= static_cast<T>(static_cast<unsigned char>(pos[i])) << (8 * i);
+    }
+    pos += sizeof(T);
+    return value;
+  }
+
+public:
+  explicit Reader(std::string_view data)
+      : pos{data.data()}, end{data.data() + data.size()} {}
+
+  std::uint8_t u8() { return get<std::uint8_t>(); }
+  std::uint16_t u16() { return get<std::uint16_t>(); }
+  std::uint32_t u32() { return get<std::uint32_t>(); }
+  std::uint64_t u64() { return get<std::uint64_t>(); }
+
+  std::string_view bytes(std::size_t n) {
+    if (static_cast<std::size_t>(end - pos) < n) {
+      error = true;
+      pos = end;
+      return {};
+    }
+    std::string_view data(pos, n);
+    pos += n;
+    return data;
+  }
+
+  // Length-prefixed string
+  std::string_view str() { return bytes(u32()); }
+
+  std::size_t remaining() const { return static_cast<std::size_t>(end - pos); }
+  bool failed() const { return error; }
+};
+
+} // namespace BinaryIO
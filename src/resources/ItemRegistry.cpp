@@ -0,0 +1,20 @@
+#include "ItemRegistry.hpp"
+
+using namespace Save;
+
+ItemId ItemRegistry::intern(std::string_view name) {
+  if (auto it = ids.find(name); it != ids.end()) {
+    return it->second;
+  }
+  auto id = static_cast<ItemId>(names.size());
+  const std::string &stored = names.emplace_back(name);
+  ids.emplace(stored, id);
+  return id;
+}
+
+std::optional<ItemId> ItemRegistry::find(std::string_view name) const {
+  if (auto it = ids.find(name); it != ids.end()) {
+    return it->second;
+  }
+  return std::nullopt;
+}
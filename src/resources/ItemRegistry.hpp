@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace Save {
+
+// Dense handle for an interned item or upgrade name
+enum class ItemId : std::uint32_t {};
+
+constexpr std::size_t index(ItemId id) { return static_cast<std::size_t>(id); }
+
+/*
+ * @class ItemRegistry
+ * @brief Interns item and upgrade names into dense ItemIds.
+ *
+ * IDs are handed out in order starting at 0, so per-item data can live in a
+ * plain vector indexed by ItemId. IDs are only stable within one run; save
+ * files store names. Names are never removed, and the string_views returned
+ * by name() stay valid for the lifetime of the program. Interning is not
+ * thread-safe and should happen on the tick thread.
+ */
+class ItemRegistry { // Singleton class
+private:
+  std::deque<std::string> names; // Stable addresses, indexed by ItemId
+  std::unordered_map<std::string_view, ItemId> ids;
+
+  ItemRegistry() = default;
+
+public:
+  static ItemRegistry &instance() {
+    static ItemRegistry instance;
+    return instance;
+  }
+
+  // Returns the ID of `name`, registering it if it is new
+  ItemId intern(std::string_view name);
+
+  std::optional<ItemId> find(std::string_view name) const;
+
+  std::string_view name(ItemId id) const { return names[index(id)]; }
+
+  // Number of registered names; every ID is below this
+  std::size_t size() const { return names.size(); }
+
+  // Prevent copying and assignment
+  ItemRegistry(const ItemRegistry &) = delete;
+  ItemRegistry &operator=(const ItemRegistry &) = delete;
+};
+
+} // namespace Save
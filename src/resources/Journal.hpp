@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "../BigNum.hpp"
+#include "BinaryIO.hpp"
+
+/* Write-ahead journal records for SaveData mutations (little-endian)
+ * Each record is: u8 op, u64 sequence, u32 ID length + ID bytes, u64 mantissa
+ * bits, u64 exponent bits (BigNum::to_bits()), u32 FNV-1a checksum of all the
+ * preceding bytes of the record. A log is a plain concatenation of records; a
+ * torn or corrupt record ends it.
+ */
+namespace Save::Journal {
+
+enum class Op : std::uint8_t {
+  AddItem = 1,
+  SubtractItem = 2,
+  SetItem = 3,
+  AddUpgradeLvl = 4,
+};
+
+struct Record {
+  Op op;
+  std::uint64_t sequence;
+  std::string_view id;
+  BigNum amount;
+};
+
+inline std::uint32_t checksum(std::string_view data) {
+  std::uint32_t hash = 2166136261u;
+  for (char c : data) {
+    hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+  }
+  return hash;
+}
+
+inline void append(std::string &out, const Record &record) {
+  std::size_t start = out.size();
+  BinaryIO::Writer w(out);
+  w.u8(static_cast<std::uint8_t>(record.op));
+  w.u64(record.sequence);
+  w.str(record.id);
+  auto [m, e] = record.amount.to_bits();
+  w.u64(m);
+  w.u64(e);
+  w.u32(checksum(std::string_view(out).substr(start)));
+}
+
+// Calls `f` with each valid record in order. Returns the number of bytes
+// consumed, which is less than data.size() if the log ends in a torn record.
+template <typename F> std::size_t forEach(std::string_view data, F &&f) {
+  std::size_t consumed = 0;
+  while (consumed < data.size()) {
+    std::string_view rest = data.substr(consumed);
+    BinaryIO::Reader r(rest);
+    auto op = static_cast<Op>(r.u8());
+    std::uint64_t sequence = r.u64();
+    std::string_view id = r.str();
+    std::uint64_t m = r.u64();
+    std::uint64_t e = r.u64();
+    std::size_t body = rest.size() - r.remaining();
+    std::uint32_t sum = r.u32();
+    if (r.failed() || sum != checksum(rest.substr(0, body)) ||
+        op < Op::AddItem || op > Op::AddUpgradeLvl) {
+      break;
+    }
+    auto amount = BigNum::from_bits(m, e);
+    if (!amount) {
+      break;
+    }
+    f(Record{op, sequence, id, *amount});
+    consumed += body + 4;
+  }
+  return consumed;
+}
+
+// Records of `data` with a sequence number after `sequence`
+inline std::string after(std::string_view data, std::uint64_t sequence) {
+  std::string out;
+  forEach(data, [&](const Record &record) {
+    if (record.sequence > sequence) {
+      append(out, record);
+    }
+  });
+  return out;
+}
+
+} // namespace Save::Journal
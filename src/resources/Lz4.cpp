@@ -0,0 +1,238 @@
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "Lz4.hpp"
+
+namespace {
+
+constexpr std::size_t MIN_MATCH = 4;
+// The block format requires the last 5 bytes to be literals, and the last
+// match to start at least 12 bytes before the end
+constexpr std::size_t LAST_LITERALS = 5;
+constexpr std::size_t MF_LIMIT = 12;
+constexpr std::size_t MAX_OFFSET = 65535;
+constexpr int HASH_LOG = 14;
+
+using Byte = unsigned char;
+
+std::uint32_t read32(const Byte *p) {
+  std::uint32_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+std::uint32_t hash(std::uint32_t sequence) {
+  return (sequence * 2654435761u) >> (32 - HASH_LOG);
+}
+
+// Number of equal bytes at `p` and `match`, stopping at `limit`
+std::size_t matchLength(const Byte *p, const Byte *match, const Byte *limit) {
+  const Byte *start = p;
+  if constexpr (std::endian::native == std::endian::little) {
+    while (limit - p >= 8) {
+      std::uint64_t a, b;
+      std::memcpy(&a, p, 8);
+      std::memcpy(&b, match, 8);
+      if (std::uint64_t diff = a ^ b) {
+        return static_cast<std::size_t>(p - start) +
+               static_cast<std::size_t>(std::countr_zero(diff) / 8);
+      }
+      p += 8;
+      match += 8;
+    }
+  }
+  while (p < limit && *p == *match) {
+    ++p;
+    ++match;
+  }
+  return static_cast<std::size_t>(p - start);
+}
+
+// Length continuation bytes, after a token nibble of 15
+Byte *writeLength(Byte *out, std::size_t length) {
+  length -= 15;
+  for (; length >= 255; length -= 255) {
+    *out++ = 255;
+  }
+  *out++ = static_cast<Byte>(length);
+  return out;
+}
+
+// Emits one sequence and returns the new end of `out`. A `match` length of
+// 0 ends the block.
+Byte *writeSequence(Byte *out, const Byte *literals, std::size_t length,
+                    std::size_t offset, std::size_t match) {
+  std::size_t extra = match ? match - MIN_MATCH : 0;
+  auto token = static_cast<unsigned>((length < 15 ? length : 15) << 4);
+  if (match) {
+    token |= static_cast<unsigned>(extra < 15 ? extra : 15);
+  }
+  *out++ = static_cast<Byte>(token);
+  if (length >= 15) {
+    out = writeLength(out, length);
+  }
+  std::memcpy(out, literals, length);
+  out += length;
+  if (match) {
+    *out++ = static_cast<Byte>(offset & 0xff);
+    *out++ = static_cast<Byte>(offset >> 8);
+    if (extra >= 15) {
+      out = writeLength(out, extra);
+    }
+  }
+  return out;
+}
+
+} // namespace
+
+std::string Lz4::compress(std::string_view data) {
+  const auto *src = reinterpret_cast<const Byte *>(data.data());
+  const std::size_t n = data.size();
+
+  // Worst case, for incompressible data
+  std::string out(n + n / 255 + 16, '\0');
+  auto *dst = reinterpret_cast<Byte *>(out.data());
+
+  std::size_t anchor = 0; // Start of pending literals
+  if (n >= MF_LIMIT + 1) {
+    std::vector<std::uint32_t> table(std::size_t{1} << HASH_LOG, 0);
+    const Byte *matchLimit = src + n - LAST_LITERALS;
+
+    std::size_t pos = 0;
+    std::size_t misses = 0;
+    while (pos + MF_LIMIT <= n) {
+      std::uint32_t sequence = read32(src + pos);
+      std::uint32_t &slot = table[hash(sequence)];
+      std::size_t candidate = slot;
+      slot = static_cast<std::uint32_t>(pos);
+
+      if (candidate >= pos || pos - candidate > MAX_OFFSET ||
+          read32(src + candidate) != sequence) {
+        // Skip ahead faster through data that doesn't compress
+        pos += 1 + (misses++ >> 6);
+        continue;
+      }
+
+      while (pos > anchor && candidate > 0 &&
+             src[pos - 1] == src[candidate - 1]) {
+        --pos;
+        --candidate;
+      }
+      std::size_t length =
+          MIN_MATCH + matchLength(src + pos + MIN_MATCH,
+                                  src + candidate + MIN_MATCH, matchLimit);
+      dst = writeSequence(dst, src + anchor, pos - anchor, pos - candidate,
+                          length);
+
+      pos += length;
+      anchor = pos;
+      misses = 0;
+      if (pos + MF_LIMIT <= n) {
+        std::size_t inside = pos - 2; // Helps find the next match sooner
+        table[hash(read32(src + inside))] = static_cast<std::uint32_t>(inside);
+      }
+    }
+  }
+  dst = writeSequence(dst, src + anchor, n - anchor, 0, 0);
+  out.resize(static_cast<std::size_t>(
+      dst - reinterpret_cast<const Byte *>(out.data())));
+  return out;
+}
+
+std::optional<std::string> Lz4::decompress(std::string_view block,
+                                           std::size_t size) {
+  // No LZ4 block expands by more than 255x, so this rejects bogus sizes
+  // before allocating
+  if (size / 255 > block.size()) {
+    return std::nullopt;
+  }
+
+  const auto *ip = reinterpret_cast<const Byte *>(block.data());
+  const Byte *end = ip + block.size();
+  std::string out(size, '\0');
+  auto *dst = reinterpret_cast<Byte *>(out.data());
+  std::size_t op = 0;
+
+  auto readLength = [&](std::size_t &length) {
+    Byte b;
+    do {
+      if (ip == end) {
+        return false;
+      }
+      b = *ip++;
+      length += b;
+    } while (b == 255);
+    return true;
+  };
+
+  while (true) {
+    if (ip == end) {
+      return std::nullopt;
+    }
+    unsigned token = *ip++;
+
+    std::size_t length = token >> 4;
+
+    // Common case: short literals and a short match far enough back, copied
+    // with fixed-size (inlined) copies
+    if (length < 15 && end - ip >= 18 && size - op >= 34) {
+      std::memcpy(dst + op, ip, 16);
+      ip += length;
+      op += length;
+      std::size_t offset = ip[0] | static_cast<std::size_t>(ip[1]) << 8;
+      std::size_t match = (token & 15) + MIN_MATCH;
+      if ((token & 15) < 15 && offset >= 16 && offset <= op) {
+        ip += 2;
+        const Byte *from = dst + op - offset;
+        std::memcpy(dst + op, from, 16);
+        std::memcpy(dst + op + 16, from + 16, 2);
+        op += match;
+        continue;
+      }
+      length = 0; // Literals done; fall through for the match
+    } else if (length == 15 && !readLength(length)) {
+      return std::nullopt;
+    }
+    if (length > static_cast<std::size_t>(end - ip) || length > size - op) {
+      return std::nullopt;
+    }
+    std::memcpy(dst + op, ip, length);
+    ip += length;
+    op += length;
+    if (ip == end) {
+      break; // The last sequence has no match
+    }
+
+    if (end - ip < 2) {
+      return std::nullopt;
+    }
+    std::size_t offset = ip[0] | static_cast<std::size_t>(ip[1]) << 8;
+    ip += 2;
+    std::size_t match = token & 15;
+    if (match == 15 && !readLength(match)) {
+      return std::nullopt;
+    }
+    match += MIN_MATCH;
+    if (offset == 0 || offset > op || match > size - op) {
+      return std::nullopt;
+    }
+
+    // Matches may overlap their own output, so copy forwards
+    const Byte *from = dst + op - offset;
+    if (offset >= match) {
+      std::memcpy(dst + op, from, match);
+    } else {
+      for (std::size_t i = 0; i < match; ++i) {
+        dst[op + i] = from[i];
+      }
+    }
+    op += match;
+  }
+
+  if (op != size) {
+    return std::nullopt;
+  }
+  return out;
+}
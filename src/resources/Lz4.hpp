@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+
+/* LZ4 block compression (https://github.com/lz4/lz4/blob/dev/doc/
+ * lz4_Block_format.md), without the frame format: callers store the
+ * uncompressed size themselves. The compressor is a single-pass greedy
+ * matcher, which trades some ratio for speed.
+ */
+namespace Lz4 {
+
+// Compresses `data` into a single LZ4 block
+std::string compress(std::string_view data);
+
+// Decompresses a block that expands to exactly `size` bytes. Returns
+// std::nullopt if the block is malformed or has a different size.
+std::optional<std::string> decompress(std::string_view block,
+                                      std::size_t size);
+
+} // namespace Lz4
@@ -0,0 +1,53 @@
+#include "Migration.hpp"
+
+using namespace Save;
+using Category = Migration::Category;
+
+namespace {
+
+// 1 -> 2: item IDs use the lowercase names from data/recipes.json
+constexpr std::array<Migration::Rename, 6> LOWERCASE_ITEMS{{
+    {Category::Items, "Bills", "bills"},
+    {Category::Items, "Iron", "iron"},
+    {Category::Items, "Copper", "copper"},
+    {Category::Items, "Iron Gear", "iron gear"},
+    {Category::Items, "Copper Wire", "copper wire"},
+    {Category::Items, "Motor", "motor"},
+}};
+
+constexpr std::array<Migration::Step, 1> STEPS{{
+    {1, LOWERCASE_ITEMS},
+}};
+
+static_assert(
+    [] {
+      for (std::size_t i = 0; i < STEPS.size(); ++i) {
+        if (STEPS[i].version != i + 1) {
+          return false;
+        }
+      }
+      return STEPS.size() == SCHEMA_VERSION - 1;
+    }(),
+    "Every schema version needs one migration step, in order");
+
+} // namespace
+
+std::span<const Migration::Step> Migration::steps() { return STEPS; }
+
+Migration::Migration(std::uint32_t version) {
+  for (const Step &step : steps()) {
+    if (step.version < version) {
+      continue;
+    }
+    for (const Rename &rename : step.renames) {
+      auto &table = renames[static_cast<std::size_t>(rename.category)];
+      // Entries already renamed to `from` by an earlier step move on too
+      for (auto &[_, to] : table) {
+        if (to == rename.from) {
+          to = rename.to;
+        }
+      }
+      table.try_emplace(rename.from, rename.to);
+    }
+  }
+}
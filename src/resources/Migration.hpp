@@ -0,0 +1,60 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <unordered_map>
+
+namespace Save {
+
+// Version of the save contents (which item and upgrade IDs exist). Bump it
+// and register a Migration::Step whenever an ID is renamed.
+inline constexpr std::uint32_t SCHEMA_VERSION = 2;
+
+/*
+ * @class Migration
+ * @brief Upgrades IDs from an older save schema while the save is loaded.
+ *
+ * Each registered step upgrades a save by one schema version. A Migration
+ * composes every step from a save's version up to SCHEMA_VERSION into one
+ * rename table per category, so loaders look each ID up once no matter how
+ * old the save is, and skip the lookup entirely for current saves.
+ */
+class Migration {
+public:
+  enum class Category { Items, Upgrades };
+
+  struct Rename {
+    Category category;
+    std::string_view from;
+    std::string_view to;
+  };
+
+  struct Step {
+    std::uint32_t version; // Upgrades saves of this version to version + 1
+    std::span<const Rename> renames;
+  };
+
+  // Steps in version order, starting at schema 1
+  static std::span<const Step> steps();
+
+  // Migrates from `version`, which must be at most SCHEMA_VERSION
+  explicit Migration(std::uint32_t version);
+
+  // The current ID for `id` from the old schema
+  std::string_view apply(Category category, std::string_view id) const {
+    const auto &table = renames[static_cast<std::size_t>(category)];
+    if (table.empty()) {
+      return id;
+    }
+    auto it = table.find(id);
+    return it != table.end() ? it->second : id;
+  }
+
+private:
+  std::array<std::unordered_map<std::string_view, std::string_view>, 2>
+      renames;
+};
+
+} // namespace Save
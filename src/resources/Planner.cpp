@@ -0,0 +1,346 @@
+#include <algorithm>
+
+#include "Planner.hpp"
+
+using RecipeId = Planner::RecipeId;
+using ItemStack = Planner::ItemStack;
+using RawCost = Planner::RawCost;
+
+namespace {
+
+// 2^53: past this, every double (and BigNum) is a whole number
+constexpr double EXACT = 9007199254740992.0;
+
+// Doublings past the raw cost estimate before maxCrafts() settles for what
+// it has; only reached by cycles that make more than they use
+constexpr std::size_t MAX_GALLOPS = 64;
+
+template <typename Num> Num floorOf(const Num &n) {
+  if (!(n < Num(EXACT))) {
+    return n;
+  }
+  // to_number() truncates, which is floor() for positive numbers
+  return Num(static_cast<double>(*n.to_number()));
+}
+
+// Crafts needed to make `amount` at `perCraft` each
+BigNum craftsFor(const BigNum &amount, const BigNum &perCraft) {
+  BigNum crafts = floorOf(amount / perCraft);
+  // The division may round across an integer. Past 2^53 a single craft is
+  // lost to rounding, so step in the last digits instead.
+  BigNum step = crafts < BigNum(EXACT) ? BigNum(1) : crafts * BigNum(1e-12);
+  while (perCraft * crafts < amount) {
+    crafts += step;
+  }
+  return crafts;
+}
+
+BigNum amountOf(std::span<const ItemStack> stacks, ItemId item) {
+  BigNum total(0);
+  for (const ItemStack &stack : stacks) {
+    if (stack.id == item) {
+      total += stack.amount;
+    }
+  }
+  return total;
+}
+
+template <typename Stack, typename Num>
+void accumulate(std::vector<Stack> &stacks, ItemId item, const Num &amount) {
+  auto it = std::ranges::find(stacks, item, &Stack::id);
+  if (it == stacks.end()) {
+    stacks.push_back(Stack{item, amount});
+  } else {
+    it->amount += amount;
+  }
+}
+
+// Inventory amounts as a plan would leave them, read from SaveData as needed
+class Stock {
+private:
+  const SaveData &save;
+  std::vector<std::optional<BigNum>> amounts; // By ItemId
+
+public:
+  explicit Stock(const SaveData &save) : save(save) {}
+
+  BigNum &operator[](ItemId item) {
+    std::size_t i = index(item);
+    if (i >= amounts.size()) {
+      amounts.resize(i + 1);
+    }
+    if (!amounts[i]) {
+      amounts[i] = save.getItem(item);
+    }
+    return *amounts[i];
+  }
+};
+
+} // namespace
+
+// Expands a craft over the graph of chosen recipes. Each item gets one node,
+// which sums what all of its users need, so shared intermediates are planned
+// (and rounded up to whole crafts) once, and the plan grows with the number
+// of items rather than the number of paths to them.
+class Planner::Expansion {
+private:
+  Planner &planner;
+  const SaveData &save;
+  Plan &plan;
+  std::vector<std::optional<std::size_t>> nodes; // By ItemId
+  std::vector<std::size_t> order; // Nodes, inputs before their users
+
+  // Adds the node of `item`, and those of its recipe's inputs, once. The
+  // chosen recipes never lead back to an item, so this terminates.
+  std::size_t visit(ItemId item) {
+    std::size_t i = index(item);
+    if (i >= nodes.size()) {
+      nodes.resize(i + 1);
+    }
+    if (nodes[i]) {
+      return *nodes[i];
+    }
+    std::size_t node = plan.nodes.size();
+    nodes[i] = node;
+    std::optional<RecipeId> recipe = planner.choice(item).recipe;
+    plan.nodes.push_back(
+        Node{item, BigNum(0), BigNum(0), recipe, BigNum(0), {}});
+    if (recipe) {
+      for (const ItemStack &input : planner.recipes.get(*recipe).inputs) {
+        std::size_t child = visit(input.id);
+        plan.nodes[node].children.push_back(child);
+      }
+    }
+    order.push_back(node);
+    return node;
+  }
+
+  // Adds what `crafts` crafts of `recipe` need to the amounts of `node`'s
+  // children, which are in the recipe's input order
+  void demand(std::size_t node, RecipeId recipe, const BigNum &crafts) {
+    const Recipes::Recipe &r = planner.recipes.get(recipe);
+    for (std::size_t k = 0; k < r.inputs.size(); ++k) {
+      plan.nodes[plan.nodes[node].children[k]].amount +=
+          r.inputs[k].amount * crafts;
+    }
+  }
+
+public:
+  Expansion(Planner &planner, const SaveData &save, Plan &plan)
+      : planner(planner), save(save), plan(plan) {}
+
+  // Plans `crafts` crafts of `recipe`, rooted at plan.nodes[0]
+  void expand(RecipeId recipe, const BigNum &crafts) {
+    const Recipes::Recipe &r = planner.recipes.get(recipe);
+    const ItemStack &output = r.outputs.front();
+    plan.nodes.push_back(Node{output.id, output.amount * crafts, BigNum(0),
+                              recipe, crafts, {}});
+    for (const ItemStack &input : r.inputs) {
+      std::size_t child = visit(input.id);
+      plan.nodes[0].children.push_back(child);
+    }
+    demand(0, recipe, crafts);
+
+    // Users come before their inputs here, so each node's amount is final
+    // by the time it is reached. Byproducts go to the inventory, and aren't
+    // counted against the plan's own needs.
+    for (auto it = order.rbegin(); it != order.rend(); ++it) {
+      Node &node = plan.nodes[*it];
+      BigNum have = save.getItem(node.item);
+      node.fromStock = have < node.amount ? have : node.amount;
+      BigNum rest = node.amount - node.fromStock;
+      if (!(rest > BigNum(0))) {
+        continue;
+      }
+      if (!node.recipe) {
+        plan.missing.push_back(ItemStack{node.item, rest});
+        continue;
+      }
+      node.crafts = craftsFor(
+          rest, amountOf(planner.recipes.get(*node.recipe).outputs, node.item));
+      demand(*it, *node.recipe, node.crafts);
+    }
+
+    for (std::size_t node : order) {
+      if (plan.nodes[node].crafts > BigNum(0)) {
+        plan.steps.push_back({*plan.nodes[node].recipe,
+                              plan.nodes[node].crafts});
+      }
+    }
+    plan.steps.push_back({recipe, crafts});
+  }
+};
+
+Planner &Planner::instance() {
+  static Planner instance;
+  return instance;
+}
+
+bool Planner::resolve(ItemId item) {
+  std::size_t i = index(item);
+  if (choices[i].state == Choice::State::Done) {
+    return true;
+  }
+  if (choices[i].state == Choice::State::Resolving) {
+    cyclic = true;
+    return false;
+  }
+  choices[i].state = Choice::State::Resolving;
+
+  std::optional<RecipeId> chosen;
+  for (RecipeId id : recipes.producing(item)) {
+    const Recipes::Recipe &recipe = recipes.get(id);
+    // Recipes from nothing are how raw items are gathered
+    if (!recipe.inputs.empty() &&
+        std::ranges::all_of(recipe.inputs, [this](const ItemStack &input) {
+          return resolve(input.id);
+        })) {
+      chosen = id;
+      break;
+    }
+  }
+
+  std::vector<RawCost> cost;
+  if (chosen) {
+    const Recipes::Recipe &recipe = recipes.get(*chosen);
+    FastBigNum perCraft(amountOf(recipe.outputs, item));
+    for (const ItemStack &input : recipe.inputs) {
+      FastBigNum amount(input.amount);
+      for (const RawCost &raw : choices[index(input.id)].rawCost) {
+        accumulate(cost, raw.id,
+                   FastBigNum(lazy(amount) * raw.amount / perCraft));
+      }
+    }
+    std::ranges::sort(cost, {}, &RawCost::id);
+  } else {
+    cost.push_back(RawCost{item, FastBigNum(1)});
+  }
+
+  Choice &done = choices[i];
+  done.recipe = chosen;
+  done.rawCost = std::move(cost);
+  done.state = Choice::State::Done;
+  return true;
+}
+
+void Planner::refresh() {
+  if (revision != recipes.getRevision() || cyclic) {
+    choices.clear();
+    revision = recipes.getRevision();
+    cyclic = false;
+  }
+}
+
+const Planner::Choice &Planner::choice(ItemId item) {
+  // Every ID a recipe mentions is interned by now
+  std::size_t size = std::max(ItemRegistry::instance().size(), index(item) + 1);
+  if (choices.size() < size) {
+    choices.resize(size);
+  }
+  (void)resolve(item);
+  return choices[index(item)];
+}
+
+const std::vector<RawCost> &Planner::rawCost(ItemId item) {
+  refresh();
+  return choice(item).rawCost;
+}
+
+Planner::Plan Planner::plan(RecipeId recipe, const BigNum &crafts,
+                            const SaveData &save) {
+  refresh();
+  Plan plan;
+  Expansion(*this, save, plan).expand(recipe, crafts);
+  return plan;
+}
+
+BigNum Planner::maxCrafts(RecipeId recipe, const SaveData &save) {
+  const Recipes::Recipe &r = recipes.get(recipe);
+  if (r.inputs.empty()) {
+    return BigNum::inf();
+  }
+
+  // Estimate: the whole inventory, valued in raw items, spent on this recipe
+  // alone. Leftovers lower the real count; byproducts can raise it.
+  refresh();
+  std::vector<RawCost> perCraft;
+  for (const ItemStack &input : r.inputs) {
+    FastBigNum amount(input.amount);
+    for (const RawCost &raw : choice(input.id).rawCost) {
+      accumulate(perCraft, raw.id, amount * raw.amount);
+    }
+  }
+  std::vector<RawCost> available;
+  for (const auto &[item, amount] : save.getItems().entries()) {
+    FastBigNum have(amount);
+    for (const RawCost &raw : choice(item).rawCost) {
+      accumulate(available, raw.id, have * raw.amount);
+    }
+  }
+  FastBigNum estimate = FastBigNum::inf();
+  for (const RawCost &need : perCraft) {
+    auto it = std::ranges::find(available, need.id, &RawCost::id);
+    FastBigNum times =
+        it == available.end() ? FastBigNum(0) : it->amount / need.amount;
+    if (times < estimate) {
+      estimate = times;
+    }
+  }
+  if (estimate.is_inf()) {
+    return BigNum::inf();
+  }
+
+  auto feasible = [&](const BigNum &crafts) {
+    return plan(recipe, crafts, save).feasible();
+  };
+
+  // Gallop up from the estimate until a plan fails
+  BigNum lo(0);
+  BigNum hi(floorOf(estimate));
+  for (std::size_t gallops = 0; feasible(hi); ++gallops) {
+    lo = hi;
+    if (gallops == MAX_GALLOPS) {
+      return lo;
+    }
+    hi = hi > BigNum(0) ? hi * BigNum(2) : BigNum(1);
+  }
+
+  // Binary search, to the nearest craft while counts are exact, and to the
+  // nearest BigNum past that
+  while (hi - lo > BigNum(1)) {
+    BigNum mid = floorOf((lo + hi) / BigNum(2));
+    if (!(lo < mid && mid < hi)) {
+      break;
+    }
+    (feasible(mid) ? lo : hi) = mid;
+  }
+  return lo;
+}
+
+bool Planner::execute(const Plan &plan, SaveData &save) const {
+  if (!plan.feasible()) {
+    return false;
+  }
+
+  // Check every step against the inventory before changing anything
+  Stock stock(save);
+  for (const Step &step : plan.steps) {
+    const Recipes::Recipe &recipe = recipes.get(step.recipe);
+    for (const ItemStack &input : recipe.inputs) {
+      BigNum &have = stock[input.id];
+      have -= input.amount * step.crafts;
+      if (have < BigNum(0)) {
+        return false;
+      }
+    }
+    for (const ItemStack &output : recipe.outputs) {
+      stock[output.id] += output.amount * step.crafts;
+    }
+  }
+
+  for (const Step &step : plan.steps) {
+    const Recipes::Recipe &recipe = recipes.get(step.recipe);
+    (void)save.craft(recipe.inputs, recipe.outputs, step.crafts);
+  }
+  return true;
+}
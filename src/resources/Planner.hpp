@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "Recipes.hpp"
+#include "SaveData.hpp"
+
+/*
+ * @class Planner
+ * @brief Expands crafts into full craft plans over the recipe graph.
+ *
+ * Items made by a recipe with inputs are intermediates, which a plan crafts
+ * when the inventory runs short. Everything else (items without a recipe,
+ * and items only handcrafted from nothing, like iron) is raw, and has to be
+ * in the inventory. Each intermediate is made with the first recipe in
+ * Recipes::producing() that doesn't lead back to the item; an item whose
+ * every recipe is part of a cycle counts as raw.
+ *
+ * The recipe choice and the per-unit raw cost of each item are memoized
+ * until the recipe table changes. Inside a cycle the choice depends on which
+ * item the lookup started from, so once a cycle is met, choices only last
+ * for one call. Raw costs are fractional (a quarter of a copper per wire),
+ * and kept in FastBigNum so they don't round to whole items.
+ *
+ * A plan has one node per item, however many recipes use it, so each
+ * intermediate is crafted in one step.
+ */
+class Planner { // Singleton class
+public:
+  using ItemStack = SaveData::ItemStack;
+  using RecipeId = Recipes::RecipeId;
+
+  // Per-unit cost in one raw item
+  struct RawCost {
+    ItemId id;
+    FastBigNum amount;
+  };
+
+  // One item in the craft graph
+  struct Node {
+    ItemId item;
+    BigNum amount;                  // Needed by all of its users
+    BigNum fromStock;               // Taken from the inventory
+    std::optional<RecipeId> recipe; // Makes the rest, unless the item is raw
+    BigNum crafts;
+    std::vector<std::size_t> children; // Nodes for the recipe's inputs
+  };
+
+  struct Step {
+    RecipeId recipe;
+    BigNum crafts;
+  };
+
+  struct Plan {
+    std::vector<Node> nodes;         // The craft graph, rooted at nodes[0]
+    std::vector<Step> steps;         // Crafts, inputs before their users
+    std::vector<ItemStack> missing;  // Raw items the inventory is short of
+    bool feasible() const { return missing.empty(); }
+  };
+
+private:
+  struct Choice {
+    enum class State : std::uint8_t { Unknown, Resolving, Done };
+    State state = State::Unknown;
+    std::optional<RecipeId> recipe; // std::nullopt for raw items
+    std::vector<RawCost> rawCost;   // By ItemId
+  };
+
+  class Expansion; // Builds one Plan, in Planner.cpp
+
+  const Recipes &recipes;
+  std::vector<Choice> choices; // By ItemId
+  std::uint64_t revision = 0;  // Of the recipe table `choices` came from
+  bool cyclic = false;         // Some choice in `choices` avoided a cycle
+
+  Planner() : recipes(Recipes::instance()) {}
+
+  // Deleted copy constructor and assignment operator
+  Planner(const Planner &) = delete;
+  Planner &operator=(const Planner &) = delete;
+
+  // Memoizes the recipe and raw cost of `item`. Returns false if `item` is
+  // being resolved further up, i.e. the caller's recipe is in a cycle.
+  bool resolve(ItemId item);
+
+  // Drops the memoized choices if the recipe table changed, or if they were
+  // made inside a cycle. Called when a public method starts.
+  void refresh();
+
+  const Choice &choice(ItemId item);
+
+public:
+  static Planner &instance();
+
+  // Per-unit cost of `item` in raw items, sorted by ItemId
+  const std::vector<RawCost> &rawCost(ItemId item);
+
+  // Expands `crafts` crafts of `recipe` against the inventory in `save`
+  Plan plan(RecipeId recipe, const BigNum &crafts, const SaveData &save);
+
+  // The most crafts of `recipe` a feasible plan allows. Input-free recipes
+  // have no limit, and return inf().
+  BigNum maxCrafts(RecipeId recipe, const SaveData &save);
+
+  // Runs every step of `plan`, or none: returns false without changing
+  // `save` if the plan isn't feasible against the current inventory
+  bool execute(const Plan &plan, SaveData &save) const;
+};
@@ -0,0 +1,206 @@
+#include <algorithm>
+
+#include "../Logger.hpp"
+#include "RateSolver.hpp"
+
+using ProducerId = RateSolver::ProducerId;
+using ItemStack = RateSolver::ItemStack;
+
+namespace {
+
+std::size_t index(ProducerId id) { return static_cast<std::size_t>(id); }
+
+FastBigNum amountOf(std::span<const ItemStack> stacks, ItemId item) {
+  FastBigNum total(0);
+  for (const ItemStack &stack : stacks) {
+    if (stack.id == item) {
+      total += FastBigNum(stack.amount);
+    }
+  }
+  return total;
+}
+
+void sortUnique(auto &ids) {
+  std::ranges::sort(ids);
+  ids.erase(std::ranges::unique(ids).begin(), ids.end());
+}
+
+} // namespace
+
+RateSolver::Flow &RateSolver::flow(ItemId item) {
+  std::size_t i = Save::index(item);
+  if (i >= flows.size()) {
+    flows.resize(i + 1);
+  }
+  return flows[i];
+}
+
+void RateSolver::link(ProducerId id, bool add) {
+  const Recipes::Recipe &recipe = recipes.get(producers[index(id)].recipe);
+  auto update = [id, add](std::vector<ProducerId> &list) {
+    auto it = std::ranges::find(list, id);
+    if (add && it == list.end()) {
+      list.push_back(id);
+    } else if (!add && it != list.end()) {
+      list.erase(it);
+    }
+  };
+  for (const ItemStack &input : recipe.inputs) {
+    update(flow(input.id).consumers);
+  }
+  for (const ItemStack &output : recipe.outputs) {
+    update(flow(output.id).producers);
+  }
+}
+
+void RateSolver::appendItems(std::vector<ItemId> &items,
+                             ProducerId id) const {
+  const Recipes::Recipe &recipe = recipes.get(producers[index(id)].recipe);
+  for (const ItemStack &input : recipe.inputs) {
+    items.push_back(input.id);
+  }
+  for (const ItemStack &output : recipe.outputs) {
+    items.push_back(output.id);
+  }
+}
+
+bool RateSolver::refresh(ItemId item) {
+  Flow &f = flow(item);
+  // Small producers still count next to ones many orders of magnitude larger
+  FastBigNumAccumulator supply;
+  FastBigNumAccumulator demand;
+  FastBigNumAccumulator consumed;
+  for (ProducerId id : f.producers) {
+    const Producer &p = producers[index(id)];
+    supply += lazy(amountOf(recipes.get(p.recipe).outputs, item)) * p.count *
+              p.speed * p.utilization;
+  }
+  for (ProducerId id : f.consumers) {
+    const Producer &p = producers[index(id)];
+    FastBigNum full =
+        lazy(amountOf(recipes.get(p.recipe).inputs, item)) * p.count * p.speed;
+    demand += full;
+    consumed += full * p.utilization;
+  }
+  f.supply = supply.value();
+  f.demand = demand.value();
+  f.consumed = consumed.value();
+
+  FastBigNum satisfied(1);
+  if (!f.producers.empty() && f.supply < f.demand) {
+    satisfied = f.supply / f.demand;
+  }
+  bool changed = satisfied != f.satisfied;
+  f.satisfied = satisfied;
+  return changed;
+}
+
+void RateSolver::solve(std::vector<ItemId> items,
+                       std::vector<ProducerId> changed) {
+  // Alternates between items and the producers their changes reach. On a
+  // chain or tree each round moves one level further; a cycle repeats
+  // until its utilizations settle.
+  for (std::size_t round = 0;
+       round < MAX_ROUNDS && !(items.empty() && changed.empty()); ++round) {
+    sortUnique(items);
+    for (ItemId item : items) {
+      if (refresh(item)) {
+        const auto &consumers = flows[Save::index(item)].consumers;
+        changed.insert(changed.end(), consumers.begin(), consumers.end());
+      }
+    }
+    items.clear();
+
+    sortUnique(changed);
+    for (ProducerId id : changed) {
+      Producer &p = producers[index(id)];
+      FastBigNum utilization(1);
+      for (const ItemStack &input : recipes.get(p.recipe).inputs) {
+        const FastBigNum &satisfied = flows[Save::index(input.id)].satisfied;
+        if (satisfied < utilization) {
+          utilization = satisfied;
+        }
+      }
+      const FastBigNum &old = p.utilization;
+      FastBigNum delta =
+          utilization > old ? utilization - old : old - utilization;
+      if (delta > TOLERANCE * (utilization > old ? utilization : old)) {
+        p.utilization = utilization;
+        appendItems(items, id);
+      }
+    }
+    changed.clear();
+  }
+
+  settled = items.empty() && changed.empty();
+  if (!settled) {
+    Logger::println("Warning: Production rates not settled after {} rounds",
+                    MAX_ROUNDS);
+  }
+}
+
+ProducerId RateSolver::add(RecipeId recipe, const BigNum &count,
+                           const FastBigNum &speed) {
+  auto id = static_cast<ProducerId>(producers.size());
+  producers.push_back(
+      Producer{recipe, FastBigNum(count), speed, FastBigNum(0)});
+  link(id, true);
+  std::vector<ItemId> items;
+  appendItems(items, id);
+  solve(std::move(items), {id});
+  return id;
+}
+
+void RateSolver::setCount(ProducerId id, const BigNum &count) {
+  producers[index(id)].count = FastBigNum(count);
+  std::vector<ItemId> items;
+  appendItems(items, id);
+  solve(std::move(items), {id});
+}
+
+void RateSolver::assign(ProducerId id, RecipeId recipe) {
+  std::vector<ItemId> items;
+  appendItems(items, id);
+  link(id, false);
+  producers[index(id)].recipe = recipe;
+  link(id, true);
+  appendItems(items, id);
+  solve(std::move(items), {id});
+}
+
+const FastBigNum &RateSolver::utilization(ProducerId id) const {
+  return producers[index(id)].utilization;
+}
+
+RateSolver::Rate RateSolver::rate(ItemId item) const {
+  std::size_t i = Save::index(item);
+  if (i >= flows.size()) {
+    return Rate{item, FastBigNum(0), FastBigNum(0)};
+  }
+  return Rate{item, flows[i].supply, flows[i].consumed};
+}
+
+std::vector<RateSolver::Rate> RateSolver::rates() const {
+  std::vector<Rate> out;
+  for (std::size_t i = 0; i < flows.size(); ++i) {
+    if (!flows[i].producers.empty() || !flows[i].consumers.empty()) {
+      out.push_back(rate(static_cast<ItemId>(i)));
+    }
+  }
+  return out;
+}
+
+std::vector<RateSolver::Bottleneck> RateSolver::bottlenecks() const {
+  std::vector<Bottleneck> out;
+  for (std::size_t i = 0; i < flows.size(); ++i) {
+    const Flow &f = flows[i];
+    if (f.satisfied < FastBigNum(1)) {
+      out.push_back(Bottleneck{static_cast<ItemId>(i), f.satisfied,
+                               f.demand - f.supply});
+    }
+  }
+  std::ranges::sort(out, [](const Bottleneck &a, const Bottleneck &b) {
+    return a.satisfied < b.satisfied;
+  });
+  return out;
+}
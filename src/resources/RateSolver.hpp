@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Recipes.hpp"
+#include "SaveData.hpp"
+
+/*
+ * @class RateSolver
+ * @brief Steady-state production rates for a set of producers.
+ *
+ * Each producer is a number of machines running one recipe at a given
+ * speed. The solver finds how fast each can actually run: a producer's
+ * utilization is the lowest satisfaction of its inputs, where an item's
+ * satisfaction is its supply over its full-speed demand. Items that no
+ * producer makes are drawn from the inventory, and never limit anything.
+ * Speeds, utilizations and rates are fractional, so they are FastBigNum,
+ * which doesn't round them to whole numbers like BigNum does.
+ *
+ * Items and producers form a sparse bipartite graph, kept as per-item
+ * lists of producers and consumers. A change re-solves only the items and
+ * producers it reaches, so changing one producer in a large factory is
+ * cheap. Producers refer to the current recipe table; reloading it
+ * invalidates the solver.
+ */
+class RateSolver {
+public:
+  using ItemStack = SaveData::ItemStack;
+  using RecipeId = Recipes::RecipeId;
+
+  enum class ProducerId : std::uint32_t {};
+
+  // Per second
+  struct Rate {
+    ItemId item;
+    FastBigNum produced;
+    FastBigNum consumed;
+    FastBigNum net() const { return produced - consumed; }
+  };
+
+  struct Bottleneck {
+    ItemId item;
+    FastBigNum satisfied; // Supply over demand, below 1
+    FastBigNum shortfall; // Per second
+  };
+
+private:
+  // Utilization changes smaller than this, relatively, are not propagated
+  static inline const FastBigNum TOLERANCE{1e-9};
+  // Rounds before giving up on a cycle that converges slowly
+  static constexpr std::size_t MAX_ROUNDS = 1000;
+
+  struct Producer {
+    RecipeId recipe;
+    FastBigNum count;
+    FastBigNum speed;       // Crafts per second, per machine
+    FastBigNum utilization; // Between 0 and 1
+  };
+
+  struct Flow {
+    std::vector<ProducerId> producers;
+    std::vector<ProducerId> consumers;
+    FastBigNum supply{0};   // At current utilization
+    FastBigNum demand{0};   // At full speed
+    FastBigNum consumed{0}; // At current utilization
+    FastBigNum satisfied{1};
+  };
+
+  const Recipes &recipes;
+  std::vector<Producer> producers; // By ProducerId
+  std::vector<Flow> flows;         // By ItemId
+  bool settled = true;             // Whether the last solve() converged
+
+  Flow &flow(ItemId item);
+
+  // Adds `id` to, or removes it from, the lists of its recipe's items
+  void link(ProducerId id, bool add);
+
+  // Recomputes the sums of `item`. Returns true if its satisfaction changed.
+  bool refresh(ItemId item);
+
+  // Propagates changes to `items` and `changed` until nothing moves, or
+  // for MAX_ROUNDS rounds
+  void solve(std::vector<ItemId> items, std::vector<ProducerId> changed);
+
+  // Items of `id`'s recipe, inputs and outputs
+  void appendItems(std::vector<ItemId> &items, ProducerId id) const;
+
+public:
+  explicit RateSolver(const Recipes &recipes = Recipes::instance())
+      : recipes(recipes) {}
+
+  ProducerId add(RecipeId recipe, const BigNum &count,
+                 const FastBigNum &speed = FastBigNum(1));
+
+  void setCount(ProducerId id, const BigNum &count);
+
+  // Switches `id` to another recipe
+  void assign(ProducerId id, RecipeId recipe);
+
+  // The fraction of full speed `id` runs at
+  const FastBigNum &utilization(ProducerId id) const;
+
+  // False if the last change left a cycle that hadn't settled after
+  // MAX_ROUNDS rounds; its rates are then approximate
+  bool converged() const { return settled; }
+
+  Rate rate(ItemId item) const;
+
+  // Every item something makes or uses, in ID order
+  std::vector<Rate> rates() const;
+
+  // Items produced slower than they are demanded, worst first
+  std::vector<Bottleneck> bottlenecks() const;
+};
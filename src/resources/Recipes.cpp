@@ -1,34 +1,244 @@
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+#include "../Logger.hpp"
 #include "Recipes.hpp"
 
-inline auto find_recipe(Recipes::RecipeSet &recipes, std::string_view id) {
-  return std::find_if(recipes.begin(), recipes.end(),
-                      [&id](const auto &recipe) {
-                        auto [r_id, rec] = recipe;
-                        return r_id == id;
-                      });
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr std::string_view HANDCRAFTING = "handcrafting";
+
+Recipes::Type parseType(const json &type) {
+  if (type.get_ref<const std::string &>() == HANDCRAFTING) {
+    return Recipes::Type::Handcrafting;
+  }
+  throw std::runtime_error(std::format("unknown type '{}'", type.dump()));
 }
 
-void Recipes::add(std::string_view id, Recipes::Recipe recipe) {
-  if (auto it = find_recipe(recipes, id); it != recipes.end()) {
-    throw std::runtime_error("Duplicate recipe id");
+std::string_view typeName(Recipes::Type type) {
+  switch (type) {
+  case Recipes::Type::Handcrafting:
+    return HANDCRAFTING;
   }
-  recipes.emplace_back(std::string{id}, std::move(recipe));
+  return "";
 }
 
-std::optional<const Recipes::Recipe> Recipes::get(std::string_view id) {
-  if (auto it = find_recipe(recipes, id); it != recipes.end()) {
-    return it->second;
+// A stack in the data file: {"item": "iron", "count": 4}. Counts may also be
+// strings, for amounts a double can't hold.
+SaveData::ItemStack parseStack(const json &j) {
+  const auto &item = j.at("item").get_ref<const std::string &>();
+  if (item.empty()) {
+    throw std::runtime_error("empty item ID");
   }
+  const json &count = j.at("count");
+  auto invalid = [&] {
+    return std::runtime_error(
+        std::format("invalid count {} for '{}'", count.dump(), item));
+  };
+  BigNum amount(0);
+  if (count.is_string()) {
+    const auto &text = count.get_ref<const std::string &>();
+    const char *end = text.data() + text.size();
+    auto [ptr, ec] = BigNum::from_chars(text.data(), end, amount);
+    if (ec != std::errc() || ptr != end) {
+      throw invalid();
+    }
+  } else {
+    amount = BigNum(count.get<double>());
+  }
+  if (!(amount > BigNum(0)) || amount.is_inf()) {
+    throw invalid();
+  }
+  return SaveData::ItemStack(item, amount);
+}
 
+} // namespace
+
+void Recipes::relink() {
+  for (std::size_t i = 0; i < recipes.size(); ++i) {
+    const Offsets &at = offsets[i];
+    std::span<const ItemStack> all = stacks;
+    recipes[i].inputs = all.subspan(at.inputs, at.outputs - at.inputs);
+    recipes[i].outputs = all.subspan(at.outputs, at.end - at.outputs);
+  }
+}
+
+std::optional<Recipes::RecipeId> Recipes::find(std::string_view id) const {
+  if (auto it = ids.find(id); it != ids.end()) {
+    return it->second;
+  }
   return std::nullopt;
 }
 
+std::span<const Recipes::RecipeId> Recipes::producing(ItemId item) const {
+  std::size_t i = Save::index(item);
+  return i < byOutput.size() ? byOutput[i] : std::span<const RecipeId>{};
+}
+
+std::span<const Recipes::RecipeId> Recipes::consuming(ItemId item) const {
+  std::size_t i = Save::index(item);
+  return i < byInput.size() ? byInput[i] : std::span<const RecipeId>{};
+}
+
+void Recipes::addToIndex(std::vector<std::vector<RecipeId>> &lists,
+                         std::span<const ItemStack> stacks, RecipeId recipe) {
+  for (const ItemStack &stack : stacks) {
+    std::size_t i = Save::index(stack.id);
+    if (i >= lists.size()) {
+      lists.resize(i + 1);
+    }
+    // Recipes are added in ID order, so a repeat would be the last entry
+    if (lists[i].empty() || lists[i].back() != recipe) {
+      lists[i].push_back(recipe);
+    }
+  }
+}
+
+Recipes::RecipeId Recipes::add(std::string_view id, Type type,
+                               std::span<const ItemStack> inputs,
+                               std::span<const ItemStack> outputs) {
+  if (outputs.empty()) {
+    throw std::runtime_error("no outputs");
+  }
+  auto recipeId = static_cast<RecipeId>(recipes.size());
+  if (!ids.try_emplace(std::string(id), recipeId).second) {
+    throw std::runtime_error(std::format("duplicate recipe id '{}'", id));
+  }
+
+  const ItemStack *before = stacks.data();
+  Offsets at{stacks.size(), stacks.size() + inputs.size(),
+             stacks.size() + inputs.size() + outputs.size()};
+  stacks.insert(stacks.end(), inputs.begin(), inputs.end());
+  stacks.insert(stacks.end(), outputs.begin(), outputs.end());
+  offsets.push_back(at);
+  recipes.push_back(Recipe{std::string(id), type, {}, {}});
+
+  if (stacks.data() != before) {
+    relink();
+  } else {
+    std::span<const ItemStack> all = stacks;
+    recipes.back().inputs = all.subspan(at.inputs, inputs.size());
+    recipes.back().outputs = all.subspan(at.outputs, outputs.size());
+  }
+
+  ++revision;
+  byType[static_cast<std::size_t>(type)].push_back(recipeId);
+  addToIndex(byOutput, outputs, recipeId);
+  addToIndex(byInput, inputs, recipeId);
+  return recipeId;
+}
+
+void Recipes::validate() const {
+  auto bills = ItemRegistry::instance().intern(Items::BILLS);
+  for (const Recipe &recipe : recipes) {
+    for (const ItemStack &input : recipe.inputs) {
+      if (input.id != bills && producing(input.id).empty()) {
+        throw std::runtime_error(
+            std::format("recipe '{}': no recipe makes input '{}'", recipe.id,
+                        input.name()));
+      }
+    }
+  }
+}
+
+bool Recipes::load(const fs::path &directory) {
+  recipes.clear();
+  offsets.clear();
+  stacks.clear();
+  ids.clear();
+  for (auto &list : byType) {
+    list.clear();
+  }
+  byOutput.clear();
+  byInput.clear();
+  ++revision;
+
+  std::vector<fs::path> files;
+  std::error_code ec;
+  for (const auto &entry : fs::directory_iterator(directory, ec)) {
+    if (entry.is_regular_file() && entry.path().extension() == ".json") {
+      files.push_back(entry.path());
+    }
+  }
+  if (ec) {
+    Logger::println("Error: Could not read data directory {}: {}",
+                    directory.string(), ec.message());
+    return false;
+  }
+  std::ranges::sort(files);
+
+  for (const fs::path &path : files) {
+    try {
+      std::ifstream file(path);
+      deserialize(json::parse(file));
+    } catch (const std::exception &ex) {
+      Logger::println("Error: Could not load {}: {}", path.string(),
+                      ex.what());
+      return false;
+    }
+  }
+  try {
+    validate();
+  } catch (const std::exception &ex) {
+    Logger::println("Error: Invalid recipes in {}: {}", directory.string(),
+                    ex.what());
+    return false;
+  }
+  Logger::println("Loaded {} recipes from {} data files", recipes.size(),
+                  files.size());
+  return true;
+}
+
 json Recipes::serialize() const {
-  // TODO json recipe serialization
-  return json();
+  auto stacksJson = [](std::span<const ItemStack> stacks) {
+    json out = json::array();
+    for (const ItemStack &stack : stacks) {
+      // Whole numbers that fit stay numbers, like in the data files
+      json count = stack.amount.serialize();
+      if (auto n = stack.amount.to_number(); n && BigNum(*n) == stack.amount) {
+        count = *n;
+      }
+      out.push_back({{"item", stack.name()}, {"count", count}});
+    }
+    return out;
+  };
+
+  json list = json::array();
+  for (const Recipe &recipe : recipes) {
+    list.push_back({{"type", typeName(recipe.type)},
+                    {"id", recipe.id},
+                    {"inputs", stacksJson(recipe.inputs)},
+                    {"outputs", stacksJson(recipe.outputs)}});
+  }
+  return {{"addRecipes", std::move(list)}};
 }
 
 void Recipes::deserialize(const json &j) {
-  // TODO json recipe deserialization
-  (void)j;
+  if (!j.contains("addRecipes")) {
+    return; // Data files may hold other content
+  }
+  std::vector<ItemStack> inputs, outputs;
+  for (const json &recipe : j.at("addRecipes")) {
+    const auto &id = recipe.at("id").get_ref<const std::string &>();
+    try {
+      if (id.empty()) {
+        throw std::runtime_error("empty recipe id");
+      }
+      Type type = parseType(recipe.at("type"));
+      inputs.clear();
+      outputs.clear();
+      for (const json &stack : recipe.at("inputs")) {
+        inputs.push_back(parseStack(stack));
+      }
+      for (const json &stack : recipe.at("outputs")) {
+        outputs.push_back(parseStack(stack));
+      }
+      add(id, type, inputs, outputs);
+    } catch (const std::exception &ex) {
+      throw std::runtime_error(std::format("recipe '{}': {}", id, ex.what()));
+    }
+  }
 }
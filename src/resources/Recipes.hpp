@@ -1,67 +1,132 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
 #include <optional>
+#include <span>
 #include <string>
 #include <string_view>
-#include <utility>
+#include <unordered_map>
 #include <vector>
 
 #include "./SaveData.hpp"
 
 using namespace Save;
 
+/*
+ * @class Recipes
+ * @brief The recipe table, loaded from the data directory at startup.
+ *
+ * Every *.json file in the data directory may list recipes under
+ * "addRecipes" (see data/recipes.json). Loading validates them and compiles
+ * them into a flat table: the input and output stacks of all recipes live
+ * in one contiguous array, with item IDs interned and amounts parsed to
+ * BigNum, so crafting never touches strings.
+ */
 class Recipes {
 private:
-  Recipes() = default;
   using ItemStack = SaveData::ItemStack;
 
 public:
+  enum class Type : std::uint8_t { Handcrafting };
+  static constexpr std::size_t TYPE_COUNT = 1;
+
+  // Index into getRecipes()
+  enum class RecipeId : std::uint32_t {};
+
   struct Recipe {
-    std::string recipe_type;
-    std::vector<SaveData::ItemStack> inputs;
-    std::vector<SaveData::ItemStack> outputs;
+    std::string id;
+    Type type;
+    // Views into the stack table
+    std::span<const ItemStack> inputs;
+    std::span<const ItemStack> outputs;
+  };
+
+private:
+  // Where a recipe's stacks start in `stacks`
+  struct Offsets {
+    std::size_t inputs;
+    std::size_t outputs;
+    std::size_t end;
+  };
 
-    Recipe(std::string_view rt, std::vector<SaveData::ItemStack> in = {},
-           std::vector<SaveData::ItemStack> out = {})
-        : recipe_type{rt}, inputs{in}, outputs{out} {}
+  // Lets `ids` be searched by std::string_view
+  struct StringHash {
+    using is_transparent = void;
+    std::size_t operator()(std::string_view str) const {
+      return std::hash<std::string_view>{}(str);
+    }
   };
 
+  std::vector<Recipe> recipes;
+  std::vector<Offsets> offsets; // By RecipeId
+  std::uint64_t revision = 0;
+  std::vector<ItemStack> stacks;
+
+  // Indexes, kept up to date by add(). Each list is in RecipeId order, and
+  // holds a recipe once even if it lists an item twice.
+  std::unordered_map<std::string, RecipeId, StringHash, std::equal_to<>> ids;
+  std::array<std::vector<RecipeId>, TYPE_COUNT> byType;
+  std::vector<std::vector<RecipeId>> byOutput; // By ItemId
+  std::vector<std::vector<RecipeId>> byInput;  // By ItemId
+
+  // Adds `recipe` to the list of each item in `stacks`
+  static void addToIndex(std::vector<std::vector<RecipeId>> &lists,
+                         std::span<const ItemStack> stacks, RecipeId recipe);
+
+  Recipes() = default;
+
+  // Points the recipes' spans back into `stacks` after it grew
+  void relink();
+
+  // Throws std::runtime_error if an input can't be obtained: no recipe
+  // outputs it, and it isn't a currency like bills
+  void validate() const;
+
+public:
   static Recipes &instance() {
     static Recipes instance;
     return instance;
   }
 
-  // TODO store as JSON and implement recipe (de)serialization
-  using RecipeSet = std::vector<std::pair<std::string, Recipe>>;
-  RecipeSet recipes{
-      {std::string(Items::IRON),
-       Recipe{"crafting", {}, {ItemStack{Items::IRON, 1}}}},
-      {std::string(Items::COPPER),
-       Recipe{"crafting", {}, {ItemStack{Items::COPPER, 1}}}},
-      {std::string(Items::IRON_GEAR), Recipe{"crafting",
-                                             {ItemStack{Items::IRON, 4}},
-                                             {ItemStack{Items::IRON_GEAR, 1}}}},
-      {std::string(Items::COPPER_WIRE),
-       Recipe{"crafting",
-              {ItemStack{Items::COPPER, 1}},
-              {ItemStack{Items::COPPER_WIRE, 3}}}},
-      {std::string(Items::MOTOR), Recipe{"crafting",
-                                         {ItemStack{Items::IRON_GEAR, 2},
-                                          ItemStack{Items::COPPER_WIRE, 10}},
-                                         {ItemStack{Items::MOTOR, 1}}}},
-      {"MOTOR_BILLS", Recipe{"crafting",
-                             {ItemStack{Items::MOTOR, 1}},
-                             {ItemStack{Items::BILLS, 20}}}}};
-
-  const RecipeSet &getRecipes() { return recipes; }
-
-  void add(std::string_view id, Recipe recipe);
-
-  std::optional<const Recipe> get(std::string_view id);
-
-  static void init();
+  const std::vector<Recipe> &getRecipes() const { return recipes; }
+
+  // Increases whenever the table changes, for caches built from it
+  std::uint64_t getRevision() const { return revision; }
+
+  const Recipe &get(RecipeId id) const {
+    return recipes[static_cast<std::size_t>(id)];
+  }
+
+  std::optional<RecipeId> find(std::string_view id) const;
+
+  // Recipes of `type`
+  std::span<const RecipeId> ofType(Type type) const {
+    return byType[static_cast<std::size_t>(type)];
+  }
+
+  // Recipes that output `item`
+  std::span<const RecipeId> producing(ItemId item) const;
+
+  // Recipes that take `item` as an input
+  std::span<const RecipeId> consuming(ItemId item) const;
+
+  // Throws std::runtime_error if `id` is taken or `outputs` is empty
+  RecipeId add(std::string_view id, Type type,
+               std::span<const ItemStack> inputs,
+               std::span<const ItemStack> outputs);
+
+  // Replaces the table with the recipes from every *.json file in
+  // `directory`, in file name order. On failure, logs the error and returns
+  // false.
+  bool load(const std::filesystem::path &directory);
 
+  // The table in the data file schema
   json serialize() const;
 
+  // Adds the recipes in `j`. Throws std::runtime_error (or a json exception)
+  // on malformed recipes.
   void deserialize(const json &j);
 };
@@ -1,110 +1,889 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <fstream>
+#include <limits>
+#include <optional>
+#include <utility>
+#include <vector>
 
 #include "../../include/json.hpp"
 #include "../Logger.hpp"
+#include "BinaryIO.hpp"
+#include "Lz4.hpp"
+#include "Migration.hpp"
 #include "SaveData.hpp"
 
 using namespace Save;
+using Journal::Op;
 
-const SaveData::Map &SaveData::getItems() const { return items; }
+static ItemRegistry &registry() { return ItemRegistry::instance(); }
 
-BigNum SaveData::getItem(const std::string_view id) const {
-  if (auto it = items.find(id); it != items.end()) {
-    return it->second;
+void SaveData::record(Op op, ItemId id, const BigNum &amount) {
+  ++version;
+  if (journaling) {
+    Journal::append(journal, {op, ++sequence, registry().name(id), amount});
+  }
+}
+
+const SaveData::Amounts &SaveData::getItems() const { return items; }
+
+BigNum SaveData::getItem(ItemId id) const {
+  if (const BigNum *amount = items.find(id)) {
+    return *amount;
   }
   return BigNum(0); // Return 0 if item not found
 }
 
+BigNum SaveData::getItem(const std::string_view id) const {
+  // Unknown names are not interned, so lookups don't grow the registry
+  auto item = registry().find(id);
+  return item ? getItem(*item) : BigNum(0);
+}
+
+void SaveData::setItem(ItemId id, const BigNum &amount) {
+  items.set(id, amount);
+  record(Op::SetItem, id, amount);
+}
+
 void SaveData::setItem(const std::string_view id, const BigNum &amount) {
-  items.insert_or_assign(std::string(id), amount);
+  setItem(registry().intern(id), amount);
+}
+
+void SaveData::addItem(ItemId id, const BigNum &amount) {
+  if (BigNum *item = items.find(id)) {
+    *item += amount;
+  } else {
+    items.set(id, amount);
+  }
+  record(Op::AddItem, id, amount);
 }
 
 void SaveData::addItem(const std::string_view id, const BigNum &amount) {
-  if (auto it = items.find(id); it != items.end()) {
-    it->second += amount; // Fix: Access .second
-    return;
+  addItem(registry().intern(id), amount);
+}
+
+void SaveData::subtractItem(ItemId id, const BigNum &amount) {
+  if (BigNum *item = items.find(id)) {
+    *item -= amount;
+    if (*item < 0)
+      *item = 0;
+  } else {
+    items.set(id, 0);
   }
-  items.emplace(
-      id, amount); // Fix: Use emplace for string_view to string conversion
+  record(Op::SubtractItem, id, amount);
 }
 
 void SaveData::subtractItem(const std::string_view id, const BigNum &amount) {
-  if (auto it = items.find(id); it != items.end()) {
-    it->second -= amount;
-    if (it->second < 0)
-      it->second = 0;
+  subtractItem(registry().intern(id), amount);
+}
+
+const SaveData::Amounts &SaveData::getUpgrades() const { return upgrades; }
+
+BigNum SaveData::getUpgradeLvl(ItemId id) const {
+  if (const BigNum *lvl = upgrades.find(id)) {
+    return *lvl;
+  }
+  return BigNum(0); // Return 0 if upgrade not found
+}
+
+BigNum SaveData::getUpgradeLvl(const std::string_view id) const {
+  auto upgrade = registry().find(id);
+  return upgrade ? getUpgradeLvl(*upgrade) : BigNum(0);
+}
+
+void SaveData::addUpgradeLvl(ItemId id, const BigNum &lvl) {
+  if (BigNum *current = upgrades.find(id)) {
+    *current += lvl;
   } else {
-    items.emplace(id, 0);
+    upgrades.set(id, lvl);
   }
+  record(Op::AddUpgradeLvl, id, lvl);
+}
+
+void SaveData::addUpgradeLvl(const std::string_view id, const BigNum &lvl) {
+  addUpgradeLvl(registry().intern(id), lvl);
 }
 
-const SaveData::Map &SaveData::getUpgrades() const { return upgrades; }
+BigNum SaveData::addUpgradeLvl(const std::string_view id,
+                               const UpgradeCost &cost, const BigNum &lvl) {
+  const BigNum owned = getUpgradeLvl(id);
 
-BigNum SaveData::getUpgradeLvl(const std::string_view id) const {
-  if (auto it = upgrades.find(id); it != upgrades.end()) {
+  // Closed form, so buying max costs the same as buying one level
+  const BigNum budget = getItem(cost.currency);
+  BigNum count =
+      BigNum::max_affordable(budget, cost.base, cost.ratio, owned);
+  if (count.is_nan() && cost.ratio < 1.0 && cost.base > BigNum(0)) {
+    // Shrinking costs have no maximum; buy `lvl` levels if they're
+    // affordable. Buying max stops where a level costs less than an ulp of
+    // the budget, as every level past that is free.
+    count = lvl;
+    if (count.is_inf()) {
+      const double lr = std::log10(cost.ratio);
+      const double next = *cost.base.log10() + owned.as_double() * lr;
+      const double ulp = *budget.log10() +
+                         std::log10(std::numeric_limits<double>::epsilon());
+      count = BigNum(std::max(1.0, std::ceil((ulp - next) / lr)));
+    }
+    if (!(BigNum::geometric_sum(cost.base, cost.ratio, owned, count) <=
+          budget)) {
+      return BigNum(0);
+    }
+  }
+  if (count.is_nan()) {
+    return BigNum(0);
+  }
+  if (lvl < count) {
+    count = lvl;
+  }
+  // Never hand out infinite levels, whatever the budget or `lvl`
+  if (count == BigNum(0) || count.is_inf()) {
+    return BigNum(0);
+  }
+
+  subtractItem(cost.currency,
+               BigNum::geometric_sum(cost.base, cost.ratio, owned, count));
+  addUpgradeLvl(id, count);
+  return count;
+}
+
+// floor(have / need), exact while the result fits a double's integers
+static BigNum timesAffordable(const BigNum &have, const BigNum &need) {
+  BigNum times = have / need;
+  if (!(times >= BigNum(1))) {
+    return BigNum(0); // Also catches NaN
+  }
+  constexpr double EXACT = 9007199254740992.0; // 2^53
+  if (times.is_inf() || times >= BigNum(EXACT)) {
+    return times; // Whole at this magnitude
+  }
+  // to_number() truncates, which is floor() for positive numbers
+  BigNum count(static_cast<double>(*times.to_number()));
+  // The division may round across an integer
+  if (need * count > have) {
+    count -= BigNum(1);
+  } else if (need * (count + BigNum(1)) <= have) {
+    count += BigNum(1);
+  }
+  return count;
+}
+
+BigNum SaveData::maxCraftable(std::span<const ItemStack> inputs) const {
+  BigNum max = BigNum::inf();
+  for (const ItemStack &input : inputs) {
+    const BigNum *have = items.find(input.id);
+    if (!have) {
+      return BigNum(0);
+    }
+    BigNum times = timesAffordable(*have, input.amount);
+    if (times < max) {
+      max = times;
+    }
+  }
+  return max;
+}
+
+BigNum SaveData::craft(std::span<const ItemStack> inputs,
+                       std::span<const ItemStack> outputs,
+                       const BigNum &count) {
+  BigNum times = count;
+  if (inputs.empty()) {
+    if (times.is_inf()) {
+      times = BigNum(1);
+    }
+  } else if (BigNum max = maxCraftable(inputs); max < times) {
+    times = max;
+  }
+  if (!(times > BigNum(0))) {
+    return BigNum(0);
+  }
+
+  for (const ItemStack &input : inputs) {
+    subtractItem(input.id, input.amount * times);
+  }
+  for (const ItemStack &output : outputs) {
+    addItem(output.id, output.amount * times);
+  }
+  return times;
+}
+
+namespace {
+
+// JSON output for a std::string
+class StringSink {
+private:
+  std::string &out;
+
+public:
+  explicit StringSink(std::string &out) : out{out} {}
+  void write(std::string_view data) { out.append(data); }
+  void put(char c) { out.push_back(c); }
+};
+
+// Buffered JSON output for a stream
+class StreamSink {
+private:
+  std::ostream &out;
+  std::array<char, 64 * 1024> buf;
+  std::size_t used = 0;
+
+public:
+  explicit StreamSink(std::ostream &out) : out{out} {}
+  ~StreamSink() { flush(); }
+
+  void flush() {
+    out.write(buf.data(), static_cast<std::streamsize>(used));
+    used = 0;
+  }
+  void write(std::string_view data) {
+    if (data.size() > buf.size() - used) {
+      flush();
+      if (data.size() > buf.size()) {
+        out.write(data.data(), static_cast<std::streamsize>(data.size()));
+        return;
+      }
+    }
+    std::copy(data.begin(), data.end(), buf.data() + used);
+    used += data.size();
+  }
+  void put(char c) {
+    if (used == buf.size()) {
+      flush();
+    }
+    buf[used++] = c;
+  }
+};
+
+// Writes a quoted string, escaped like nlohmann::json::dump()
+template <typename Sink> void writeString(Sink &out, std::string_view str) {
+  static constexpr std::string_view HEX = "0123456789abcdef";
+  out.put('"');
+  std::size_t run = 0; // Start of the current run of unescaped characters
+  for (std::size_t i = 0; i < str.size(); ++i) {
+    auto c = static_cast<unsigned char>(str[i]);
+    if (c >= 0x20 && c != '"' && c != '\\') {
+      continue;
+    }
+    out.write(str.substr(run, i - run));
+    run = i + 1;
+    out.put('\\');
+    switch (c) {
+    case '"':
+    case '\\':
+      out.put(static_cast<char>(c));
+      break;
+    case '\b':
+      out.put('b');
+      break;
+    case '\t':
+      out.put('t');
+      break;
+    case '\n':
+      out.put('n');
+      break;
+    case '\f':
+      out.put('f');
+      break;
+    case '\r':
+      out.put('r');
+      break;
+    default:
+      out.write("u00");
+      out.put(HEX[c >> 4]);
+      out.put(HEX[c & 0xf]);
+      break;
+    }
+  }
+  out.write(str.substr(run));
+  out.put('"');
+}
+
+// Writes a category object with its keys sorted, as nlohmann::json does
+template <typename Sink, typename Names>
+void writeCategory(Sink &out, const SaveData::Amounts &amounts,
+                   const Names &name) {
+  std::vector<std::pair<std::string_view, const BigNum *>> sorted;
+  sorted.reserve(amounts.count());
+  for (const auto &[id, amount] : amounts.entries()) {
+    sorted.emplace_back(name(id), &amount);
+  }
+  std::ranges::sort(sorted, {}, [](const auto &entry) { return entry.first; });
+
+  std::array<char, 64> buf;
+  out.put('{');
+  bool first = true;
+  for (const auto &[key, amount] : sorted) {
+    if (!first) {
+      out.put(',');
+    }
+    first = false;
+    writeString(out, key);
+    out.put(':');
+    auto [end, ec] = amount->serialize_to(buf.data(), buf.data() + buf.size());
+    if (ec == std::errc()) {
+      writeString(out, std::string_view(buf.data(), end));
+    } else {
+      writeString(out, amount->serialize());
+    }
+  }
+  out.put('}');
+}
+
+} // namespace
+
+template <typename Sink, typename Names>
+void SaveData::toJson(Sink &out, const Amounts &items, const Amounts &upgrades,
+                      const Names &name, std::uint64_t sequence) {
+  // Keys are sorted, as dump() sorts them, so "version" comes last. The
+  // loader holds entries back until it has read it.
+  std::array<char, 24> buf;
+  out.write("{\"items\":");
+  writeCategory(out, items, name);
+  if (sequence != 0) {
+    auto [end, _] =
+        std::to_chars(buf.data(), buf.data() + buf.size(), sequence);
+    out.write(",\"sequence\":");
+    out.write(std::string_view(buf.data(), end));
+  }
+  out.write(",\"upgrades\":");
+  writeCategory(out, upgrades, name);
+  auto [versionEnd, _] =
+      std::to_chars(buf.data(), buf.data() + buf.size(), SCHEMA_VERSION);
+  out.write(",\"version\":");
+  out.write(std::string_view(buf.data(), versionEnd));
+  out.put('}');
+}
+
+namespace {
+
+// SAX handler that reads a JSON save without building a DOM. Values in the
+// "items" and "upgrades" objects are parsed and set as they arrive;
+// non-string or malformed values load as 0, and unknown keys are skipped.
+// IDs are migrated from the save's "version" (1 if missing). Sorted keys, as
+// toJson() writes them, put "version" last, so entries read before it are
+// set under their names as they are, which is right for current saves. The
+// few whose name some migration renames are noted, and moved to their new
+// IDs in place once the version is known.
+class JsonLoader : public nlohmann::json_sax<json> {
+private:
+  // An entry set before "version" under a name an older schema used
+  struct Renamable {
+    SaveData::Amounts *category;
+    Migration::Category kind;
+    ItemId id;
+  };
+
+  SaveData::Amounts &items;
+  SaveData::Amounts &upgrades;
+  std::uint64_t &sequence;
+  std::uint32_t &schema;
+  Migration migration{SCHEMA_VERSION};
+  bool versionRead = false;
+  std::vector<Renamable> renamable;
+
+  std::size_t depth = 0;
+  std::string topKey;                    // Current key at depth 1
+  SaveData::Amounts *category = nullptr; // Object being read, if any
+  Migration::Category kind{};            // Category of `category`
+  std::optional<std::string> name;       // Current key in `category`
+  std::size_t skipDepth = 0;             // Nested value being skipped
+
+  bool inCategory() const { return category && depth == 2 && !skipDepth; }
+
+  void setCurrent(const BigNum &amount) {
+    if (!inCategory() || !name) {
+      return;
+    }
+    // Every rename of every schema, to spot old names before "version"
+    static const Migration oldest(1);
+    auto &registry = ItemRegistry::instance();
+    const ItemId id = registry.intern(migration.apply(kind, *name));
+    category->set(id, amount);
+    if (!versionRead && oldest.apply(kind, *name) != *name) {
+      renamable.push_back({category, kind, id});
+    }
+    name.reset();
+  }
+
+  // Migrates the rest of the save from schema `from`, and moves the entries
+  // noted in `renamable` to their new IDs. A moved entry replaces one
+  // already under its new ID.
+  void migrate(std::uint32_t from) {
+    migration = Migration(from);
+    auto &registry = ItemRegistry::instance();
+    for (const Renamable &entry : renamable) {
+      const BigNum *amount = std::as_const(*entry.category).find(entry.id);
+      const std::string_view old = registry.name(entry.id);
+      const std::string_view to = migration.apply(entry.kind, old);
+      if (!amount || to == old) {
+        continue;
+      }
+      const BigNum moved = *amount;
+      entry.category->erase(entry.id);
+      entry.category->set(registry.intern(to), moved);
+    }
+    renamable.clear();
+  }
+
+  bool scalar() {
+    setCurrent(BigNum(0));
+    return true;
+  }
+
+  bool open() {
+    if (skipDepth) {
+      ++skipDepth;
+    } else if (depth == 1 && (topKey == "items" || topKey == "upgrades")) {
+      bool isItems = topKey == "items";
+      category = isItems ? &items : &upgrades;
+      kind = isItems ? Migration::Category::Items
+                     : Migration::Category::Upgrades;
+    } else if (inCategory()) {
+      setCurrent(BigNum(0));
+      skipDepth = 1;
+    }
+    ++depth;
+    return true;
+  }
+
+  bool close() {
+    --depth;
+    if (skipDepth) {
+      --skipDepth;
+    } else if (depth == 1) {
+      category = nullptr;
+    } else if (depth == 0 && !versionRead) {
+      schema = 1; // No "version": the save is from before versioning
+      migrate(schema);
+    }
+    return true;
+  }
+
+  bool setVersion(std::uint64_t version) {
+    if (version == 0 || version > SCHEMA_VERSION) {
+      error = std::format("unsupported version {}", version);
+      return false;
+    }
+    if (versionRead && version != schema) {
+      error = "conflicting \"version\" keys";
+      return false;
+    }
+    schema = static_cast<std::uint32_t>(version);
+    versionRead = true;
+    migrate(schema);
+    return true;
+  }
+
+public:
+  std::string error;
+
+  JsonLoader(SaveData::Amounts &items, SaveData::Amounts &upgrades,
+             std::uint64_t &sequence, std::uint32_t &schema)
+      : items{items}, upgrades{upgrades}, sequence{sequence}, schema{schema} {
+    schema = SCHEMA_VERSION; // Until "version" says otherwise
+  }
+
+  bool null() override { return scalar(); }
+  bool boolean(bool) override { return scalar(); }
+  bool number_integer(number_integer_t) override { return scalar(); }
+  bool number_unsigned(number_unsigned_t value) override {
+    if (depth == 1 && !skipDepth && topKey == "sequence") {
+      sequence = value;
+    } else if (depth == 1 && !skipDepth && topKey == "version") {
+      return setVersion(value);
+    }
+    return scalar();
+  }
+  bool number_float(number_float_t, const string_t &) override {
+    return scalar();
+  }
+  bool binary(binary_t &) override { return scalar(); }
+
+  bool string(string_t &value) override {
+    if (!inCategory() || !name) {
+      return true;
+    }
+    BigNum amount(0);
+    const char *end = value.data() + value.size();
+    auto [ptr, ec] = BigNum::from_chars(value.data(), end, amount);
+    if (ec != std::errc() || ptr != end) {
+      // "12abc" is as invalid as "abc", not 12
+      Logger::println("Warning: invalid number for {}.{}: {}", topKey, *name,
+                      value);
+      amount = BigNum(0);
+    }
+    setCurrent(amount);
+    return true;
+  }
+
+  bool key(string_t &value) override {
+    if (skipDepth) {
+      return true;
+    }
+    if (depth == 1) {
+      topKey = value;
+    } else if (inCategory()) {
+      name = std::move(value);
+    }
+    return true;
+  }
+
+  bool start_object(std::size_t) override { return open(); }
+  bool end_object() override { return close(); }
+  bool start_array(std::size_t) override { return open(); }
+  bool end_array() override { return close(); }
+
+  bool parse_error(std::size_t position, const std::string &,
+                   const nlohmann::detail::exception &ex) override {
+    error = std::format("invalid json at byte {}: {}", position, ex.what());
+    return false;
+  }
+};
+
+} // namespace
+
+template <typename Input> bool SaveData::fromJson(Input &&input) {
+  JsonLoader loader(items, upgrades, sequence, schema);
+  if (!json::sax_parse(std::forward<Input>(input), &loader)) {
+    Logger::println("Error: Could not load json save: {}", loader.error);
+    return false;
+  }
+  return true;
+}
+
+/* Binary save format (little-endian)
+ * header:       magic "IGSV", u16 version, u16 category count, u64 journal
+ *               sequence (since version 2), u32 schema version (since
+ *               version 3, see Migration.hpp)
+ * string table: u32 count, then u32 length + bytes for each item/upgrade ID
+ * categories:   u32 name (string index), u32 count, then `count` u32 ID
+ *               indices, followed by `count` packed (u64, u64) mantissa and
+ *               exponent bit patterns from BigNum::to_bits()
+ */
+static constexpr std::string_view BINARY_MAGIC = "IGSV";
+static constexpr std::uint16_t BINARY_VERSION = 3;
+
+std::string SaveData::toBinary(const Snapshot &snapshot) {
+  const std::array<std::pair<std::string_view, const Amounts *>, 2>
+      categories{
+          {{"items", &snapshot.items}, {"upgrades", &snapshot.upgrades}}};
+
+  // Every ID and category name is stored once
+  std::vector<std::string_view> strings;
+  std::unordered_map<std::string_view, std::uint32_t> indices;
+  auto intern = [&](std::string_view str) {
+    auto [it, inserted] =
+        indices.try_emplace(str, static_cast<std::uint32_t>(strings.size()));
+    if (inserted) {
+      strings.push_back(str);
+    }
     return it->second;
+  };
+  for (const auto &[name, amounts] : categories) {
+    intern(name);
+    for (const auto &[id, _] : amounts->entries()) {
+      intern(snapshot.name(id));
+    }
   }
-  return BigNum(0); // Return 0 if item not found
+
+  std::string out;
+  BinaryIO::Writer w(out);
+  w.bytes(BINARY_MAGIC);
+  w.u16(BINARY_VERSION);
+  w.u16(static_cast<std::uint16_t>(categories.size()));
+  w.u64(snapshot.sequence);
+  w.u32(SCHEMA_VERSION);
+
+  w.u32(static_cast<std::uint32_t>(strings.size()));
+  for (auto str : strings) {
+    w.str(str);
+  }
+
+  for (const auto &[name, amounts] : categories) {
+    w.u32(indices.at(name));
+    w.u32(static_cast<std::uint32_t>(amounts->count()));
+    for (const auto &[id, _] : amounts->entries()) {
+      w.u32(indices.at(snapshot.name(id)));
+    }
+    for (const auto &[_, amount] : amounts->entries()) {
+      auto [m, e] = amount.to_bits();
+      w.u64(m);
+      w.u64(e);
+    }
+  }
+  return out;
 }
 
-void SaveData::addUpgradeLvl(const std::string_view id, const BigNum &lvl) {
-  if (auto it = upgrades.find(id); it != upgrades.end()) {
-    it->second += lvl;
-  } else {
-    upgrades.emplace(id, lvl);
+bool SaveData::fromBinary(std::string_view data) {
+  BinaryIO::Reader r(data);
+  if (r.bytes(BINARY_MAGIC.size()) != BINARY_MAGIC) {
+    return false;
+  }
+  std::uint16_t version = r.u16();
+  if (version == 0 || version > BINARY_VERSION) {
+    Logger::println("Error: Unsupported save version {}", version);
+    return false;
+  }
+  std::uint16_t n_categories = r.u16();
+  if (version >= 2) {
+    sequence = r.u64();
+  }
+  schema = version >= 3 ? r.u32() : 1;
+  if (schema == 0 || schema > SCHEMA_VERSION) {
+    Logger::println("Error: Unsupported save schema {}", schema);
+    return false;
+  }
+  const Migration migration(schema);
+
+  // Each string needs at least its length prefix
+  std::uint32_t n_strings = r.u32();
+  if (n_strings > r.remaining() / 4) {
+    return false;
+  }
+  std::vector<std::string_view> strings(n_strings);
+  for (auto &str : strings) {
+    str = r.str();
+  }
+
+  std::vector<std::uint32_t> ids;
+  for (std::uint16_t c = 0; c < n_categories && !r.failed(); ++c) {
+    std::uint32_t name = r.u32();
+    std::uint32_t count = r.u32();
+    if (name >= n_strings || count > r.remaining() / 20) {
+      return false;
+    }
+
+    // Unknown categories are skipped, for forward compatibility
+    Amounts *map = strings[name] == "items"      ? &items
+                   : strings[name] == "upgrades" ? &upgrades
+                                                 : nullptr;
+    auto kind = map == &items ? Migration::Category::Items
+                              : Migration::Category::Upgrades;
+
+    ids.resize(count);
+    for (auto &id : ids) {
+      id = r.u32();
+      if (id >= n_strings) {
+        return false;
+      }
+    }
+    for (std::uint32_t id : ids) {
+      std::uint64_t m = r.u64();
+      std::uint64_t e = r.u64();
+      auto amount = BigNum::from_bits(m, e);
+      if (!amount) {
+        return false;
+      }
+      if (map) {
+        map->set(registry().intern(migration.apply(kind, strings[id])),
+                 *amount);
+      }
+    }
   }
+  return !r.failed();
+}
+
+/* Compressed saves (little-endian)
+ * header: magic "IGLZ", u64 uncompressed size
+ * body:   a single LZ4 block holding a binary or JSON save
+ */
+static constexpr std::string_view COMPRESSED_MAGIC = "IGLZ";
+
+static std::string compress(std::string_view data) {
+  std::string out;
+  BinaryIO::Writer w(out);
+  w.bytes(COMPRESSED_MAGIC);
+  w.u64(data.size());
+  out += Lz4::compress(data);
+  return out;
 }
 
-void saveCategory(json &j, const std::string &category,
-                  const SaveData::Map &map) {
-  auto &j_category = j[category] = json::object();
+static std::optional<std::string> decompress(std::string_view data) {
+  BinaryIO::Reader r(data);
+  if (r.bytes(COMPRESSED_MAGIC.size()) != COMPRESSED_MAGIC) {
+    return std::nullopt;
+  }
+  std::uint64_t size = r.u64();
+  if (r.failed()) {
+    return std::nullopt;
+  }
+  return Lz4::decompress(data.substr(data.size() - r.remaining()),
+                         static_cast<std::size_t>(size));
+}
 
-  for (const auto &item : map) {
-    j_category[item.first] = item.second.serialize();
+SaveData::Format SaveData::formatFor(const std::filesystem::path &path) {
+  std::filesystem::path name = path;
+  if (compressionFor(path) == Compression::Lz4) {
+    name = path.stem();
   }
+  return name.extension() == ".json" ? Format::Json : Format::Binary;
 }
 
-json SaveData::toJson() const {
-  json j = json::object();
-  saveCategory(j, "items", items);
-  saveCategory(j, "upgrades", upgrades);
-  return j;
+SaveData::Compression
+SaveData::compressionFor(const std::filesystem::path &path) {
+  return path.extension() == ".lz4" ? Compression::Lz4 : Compression::None;
 }
 
-void readCategory(const json &j, const std::string &category,
-                  SaveData::Map &map) {
-  if (j.contains(category) && j[category].is_object()) {
-    const auto &j_category = j[category];
+void SaveData::serialize(std::ofstream &file, Format format,
+                         Compression compression) {
+  if (format == Format::Json && compression == Compression::None) {
+    {
+      StreamSink out(file);
+      toJson(out, items, upgrades,
+             [](ItemId id) { return registry().name(id); }, sequence);
+      out.put('\n');
+    }
+    file.flush();
+    return;
+  }
+  std::string data = encode(*publish(), format, compression);
+  file.write(data.data(), static_cast<std::streamsize>(data.size()));
+  file.flush();
+}
 
-    for (auto it = j_category.begin(); it != j_category.end(); ++it) {
-      std::string key = it.key();
-      auto &value = it.value();
+std::shared_ptr<const SaveData::Snapshot> SaveData::publish() {
+  auto latest = published.load(std::memory_order_relaxed);
+  if (latest && latest->version == version) {
+    return latest;
+  }
 
-      std::string valueStr = value.is_string() ? value.get<std::string>() : "0";
-      map[key] = BigNum::deserialize(valueStr);
+  auto next = std::make_shared<Snapshot>();
+  next->items = items.share();
+  next->upgrades = upgrades.share();
+  next->sequence = sequence;
+  next->version = version;
+  // IDs are never reused, so the names are shared until new ones register
+  if (latest && latest->names->size() == registry().size()) {
+    next->names = latest->names;
+  } else {
+    auto names = latest ? std::make_shared<std::vector<std::string_view>>(
+                              *latest->names)
+                        : std::make_shared<std::vector<std::string_view>>();
+    for (std::size_t i = names->size(); i < registry().size(); ++i) {
+      names->push_back(registry().name(static_cast<ItemId>(i)));
     }
+    next->names = std::move(names);
+  }
+
+  latest = std::move(next);
+  published.store(latest, std::memory_order_release);
+  return latest;
+}
+
+void SaveData::publishViewed() {
+  if (viewed.exchange(false, std::memory_order_relaxed)) {
+    (void)publish();
   }
 }
 
-void SaveData::fromJson(const json &j) {
-  readCategory(j, "items", items);
-  readCategory(j, "upgrades", upgrades);
+std::string SaveData::encode(const Snapshot &snapshot, Format format,
+                             Compression compression) {
+  std::string data;
+  if (format == Format::Binary) {
+    data = toBinary(snapshot);
+  } else {
+    StringSink out(data);
+    toJson(out, snapshot.items, snapshot.upgrades,
+           [&](ItemId id) { return snapshot.name(id); },
+           snapshot.sequence);
+    out.put('\n');
+  }
+  return compression == Compression::Lz4 ? compress(data) : data;
 }
 
-void SaveData::serialize(std::ofstream &file) const {
-  json j = SaveData::toJson();
-  file << j.dump() << std::endl;
+static std::string readAll(std::ifstream &file) {
+  std::string data;
+  file.seekg(0, std::ios::end);
+  data.resize(
+      static_cast<std::size_t>(std::max<std::streamoff>(file.tellg(), 0)));
+  file.seekg(0, std::ios::beg);
+  file.read(data.data(), static_cast<std::streamsize>(data.size()));
+  data.resize(static_cast<std::size_t>(file.gcount()));
+  return data;
 }
 
-void SaveData::deserialize(std::ifstream &file) {
-  json j;
-  try {
-    file >> j;
-  } catch (const std::exception &e) {
-    Logger::println("Error: Could not parse json! Is data corrupted? {}",
-                    e.what());
-    std::exit(EXIT_FAILURE);
+bool SaveData::deserialize(std::ifstream &file) {
+  std::array<char, BINARY_MAGIC.size()> buf{};
+  file.read(buf.data(), buf.size());
+  std::string_view magic(buf.data(), buf.size());
+  file.clear();
+  file.seekg(0, std::ios::beg);
+
+  auto readBinary = [this](std::string_view data) {
+    if (!fromBinary(data)) {
+      Logger::println("Error: Could not read binary save! Is data corrupted?");
+      return false;
+    }
+    return true;
+  };
+
+  // Binary and compressed saves are compact enough to read whole; JSON is
+  // parsed as it streams in
+  bool loaded = false;
+  if (magic == COMPRESSED_MAGIC) {
+    if (auto data = decompress(readAll(file)); !data) {
+      Logger::println("Error: Could not decompress save! Is data corrupted?");
+    } else if (data->starts_with(BINARY_MAGIC)) {
+      loaded = readBinary(*data);
+    } else {
+      loaded = fromJson(*data);
+    }
+  } else if (magic == BINARY_MAGIC) {
+    loaded = readBinary(readAll(file));
+  } else {
+    loaded = fromJson(file);
+  }
+
+  if (!loaded) {
+    items = {};
+    upgrades = {};
+    sequence = 0;
+    schema = SCHEMA_VERSION;
   }
+  ++version;
+  return loaded;
+}
+
+void SaveData::enableJournal() { journaling = true; }
 
-  SaveData::fromJson(j);
+std::string SaveData::takeJournal() { return std::exchange(journal, {}); }
+
+std::size_t SaveData::replayJournal(std::ifstream &file) {
+  std::string data = readAll(file);
+
+  // Replayed records are already in the log
+  bool wasJournaling = std::exchange(journaling, false);
+  const std::uint64_t saved = sequence;
+  // The log was written alongside the loaded save, with its IDs
+  const Migration migration(schema);
+  using Category = Migration::Category;
+  std::size_t applied = 0;
+  std::size_t consumed = Journal::forEach(data, [&](const Journal::Record &r) {
+    if (r.sequence <= saved) {
+      return;
+    }
+    switch (r.op) {
+    case Op::AddItem:
+      addItem(migration.apply(Category::Items, r.id), r.amount);
+      break;
+    case Op::SubtractItem:
+      subtractItem(migration.apply(Category::Items, r.id), r.amount);
+      break;
+    case Op::SetItem:
+      setItem(migration.apply(Category::Items, r.id), r.amount);
+      break;
+    case Op::AddUpgradeLvl:
+      addUpgradeLvl(migration.apply(Category::Upgrades, r.id), r.amount);
+      break;
+    }
+    sequence = std::max(sequence, r.sequence);
+    ++applied;
+  });
+  journaling = wasJournaling;
+
+  if (consumed < data.size()) {
+    Logger::println("Warning: Ignoring {} bytes of torn or corrupt journal",
+                    data.size() - consumed);
+  }
+  return applied;
 }
@@ -1,43 +1,40 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <cstdint>
+#include <filesystem>
 #include <format>
 #include <fstream>
 #include <functional>
+#include <istream>
+#include <memory>
+#include <ranges>
+#include <span>
 #include <string>
 #include <string_view>
-#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "../game.hpp"
+#include "ItemRegistry.hpp"
+#include "Journal.hpp"
+#include "Migration.hpp"
 
 namespace Save {
 using namespace std::string_view_literals;
 
-// A custom hash function object that can handle std::string, std::string_view,
-// and const char*
-struct StringHash {
-  // This using declaration enables the heterogeneous lookup
-  using is_transparent = void;
-
-  [[nodiscard]] size_t operator()(std::string_view txt) const {
-    return std::hash<std::string_view>{}(txt);
-  }
-  [[nodiscard]] size_t operator()(const std::string &txt) const {
-    return std::hash<std::string>{}(txt);
-  }
-  [[nodiscard]] size_t operator()(const char *txt) const {
-    return std::hash<std::string_view>{}(
-        txt); // use string_view hash for const char*
-  }
-};
-
 // List of all Items
 namespace Items {
-static constexpr auto BILLS = "Bills"sv;
-static constexpr auto IRON = "Iron"sv;
-static constexpr auto COPPER = "Copper"sv;
-static constexpr auto IRON_GEAR = "Iron Gear"sv;
-static constexpr auto COPPER_WIRE = "Copper Wire"sv;
-static constexpr auto MOTOR = "Motor"sv;
+// Renaming one needs a Migration step (see Migration.hpp)
+static constexpr auto BILLS = "bills"sv;
+static constexpr auto IRON = "iron"sv;
+static constexpr auto COPPER = "copper"sv;
+static constexpr auto IRON_GEAR = "iron gear"sv;
+static constexpr auto COPPER_WIRE = "copper wire"sv;
+static constexpr auto MOTOR = "motor"sv;
 } // namespace Items
 
 namespace Upgrades {
@@ -46,16 +43,171 @@ static constexpr auto DRONE_CRAFTING = "DroneCraftingUnlock"sv;
 
 class SaveData {
 public:
-  using Map =
-      std::unordered_map<std::string, BigNum, StringHash, std::equal_to<>>;
+  // Amounts of one category (items or upgrades), indexed by ItemId. An ID
+  // has an entry once it has been set in this category.
+  //
+  // Entries live in fixed-size chunks that copies made with share() point
+  // to as well. A chunk is copied on a write while another copy still points
+  // to it, so sharing costs one pointer per chunk, later writes never show
+  // up in the copy, and chunks no copy holds anymore are written in place.
+  class Amounts {
+  private:
+    static constexpr std::size_t CHUNK_SIZE = 32;
+
+    struct alignas(64) Chunk {
+      std::array<BigNum, CHUNK_SIZE> amounts{};
+      std::bitset<CHUNK_SIZE> present;
+    };
+
+    std::vector<std::shared_ptr<Chunk>> chunks;
+
+    Chunk &writable(std::size_t c) {
+      // With a count of 1 no copy can reach the chunk to share it again.
+      // The fence orders these writes after the reads of a copy that was
+      // just released on another thread.
+      if (chunks[c].use_count() > 1) {
+        chunks[c] = std::make_shared<Chunk>(*chunks[c]);
+      } else {
+        std::atomic_thread_fence(std::memory_order_acquire);
+      }
+      return *chunks[c];
+    }
+
+  public:
+    Amounts() = default;
+    Amounts(Amounts &&) = default;
+    Amounts &operator=(Amounts &&) = default;
+    // Copies must go through share(), to make sharing explicit
+    Amounts(const Amounts &) = delete;
+    Amounts &operator=(const Amounts &) = delete;
+
+    // A copy sharing every chunk with this one
+    Amounts share() const {
+      Amounts copy;
+      copy.chunks = chunks;
+      return copy;
+    }
+
+    const BigNum *find(ItemId id) const {
+      std::size_t i = index(id);
+      if (i / CHUNK_SIZE >= chunks.size()) {
+        return nullptr;
+      }
+      const Chunk &chunk = *chunks[i / CHUNK_SIZE];
+      return chunk.present[i % CHUNK_SIZE] ? &chunk.amounts[i % CHUNK_SIZE]
+                                           : nullptr;
+    }
+    BigNum *find(ItemId id) {
+      std::size_t i = index(id);
+      if (!std::as_const(*this).find(id)) {
+        return nullptr;
+      }
+      return &writable(i / CHUNK_SIZE).amounts[i % CHUNK_SIZE];
+    }
+
+    void set(ItemId id, const BigNum &amount) {
+      std::size_t i = index(id);
+      while (i / CHUNK_SIZE >= chunks.size()) {
+        chunks.push_back(std::make_shared<Chunk>());
+      }
+      Chunk &chunk = writable(i / CHUNK_SIZE);
+      chunk.amounts[i % CHUNK_SIZE] = amount;
+      chunk.present[i % CHUNK_SIZE] = true;
+    }
+
+    // Removes the entry of `id`, if it has one
+    void erase(ItemId id) {
+      if (!std::as_const(*this).find(id)) {
+        return;
+      }
+      std::size_t i = index(id);
+      Chunk &chunk = writable(i / CHUNK_SIZE);
+      chunk.amounts[i % CHUNK_SIZE] = BigNum();
+      chunk.present[i % CHUNK_SIZE] = false;
+    }
+
+    // Number of entries
+    std::size_t count() const {
+      std::size_t n = 0;
+      for (const auto &chunk : chunks) {
+        n += chunk->present.count();
+      }
+      return n;
+    }
+
+    // (ItemId, const BigNum &) pairs, in ID order
+    auto entries() const {
+      return std::views::iota(std::size_t{0}, chunks.size() * CHUNK_SIZE) |
+             std::views::filter([this](std::size_t i) {
+               return chunks[i / CHUNK_SIZE]->present[i % CHUNK_SIZE];
+             }) |
+             std::views::transform([this](std::size_t i) {
+               return std::pair<ItemId, const BigNum &>{
+                   static_cast<ItemId>(i),
+                   chunks[i / CHUNK_SIZE]->amounts[i % CHUNK_SIZE]};
+             });
+    }
+  };
+
+  // On-disk formats. Binary is the default; JSON is kept for exporting and
+  // hand-editing saves. Loading detects the format from the file contents.
+  enum class Format { Json, Binary };
+
+  // Either format can be wrapped in LZ4 compression (see Lz4.hpp), which is
+  // also detected when loading
+  enum class Compression { None, Lz4 };
+
+  // Immutable, versioned view of the saved state, which any thread may read
+  // and hold while the tick thread keeps mutating SaveData. Views share
+  // unchanged chunks with each other and with SaveData.
+  struct Snapshot {
+    Amounts items;
+    Amounts upgrades;
+    // ItemRegistry names, by ItemId
+    std::shared_ptr<const std::vector<std::string_view>> names;
+    std::uint64_t sequence = 0;
+    std::uint64_t version = 0; // Increases with every change to SaveData
+
+    std::string_view name(ItemId id) const { return (*names)[index(id)]; }
+  };
 
 private:
-  Map items{};
-  Map upgrades{};
+  Amounts items{};
+  Amounts upgrades{};
   SaveData() = default;
 
-  void fromJson(const json &);
-  json toJson() const;
+  // Journal mode state. `sequence` numbers the last journaled mutation and is
+  // saved with the data, so replaying skips records the save already has.
+  bool journaling = false;
+  std::uint64_t sequence = 0;
+  // Schema of the loaded save (and of its journal). Loaded IDs are always
+  // migrated to SCHEMA_VERSION, which is what gets saved.
+  std::uint32_t schema = SCHEMA_VERSION;
+  std::string journal; // Records not yet taken by takeJournal()
+
+  // Copy-on-write views. `version` counts changes; publish() skips making a
+  // new Snapshot while it matches the published one. `viewed` is set by
+  // view(), so the tick only publishes for readers that asked.
+  std::uint64_t version = 0;
+  std::atomic<std::shared_ptr<const Snapshot>> published;
+  mutable std::atomic<bool> viewed = false;
+
+  // Called by every mutation: bumps `version`, and journals the change in
+  // journal mode
+  void record(Journal::Op op, ItemId id, const BigNum &amount);
+
+  // Streams a JSON save (from a stream or a string) into `items` and
+  // `upgrades`
+  template <typename Input> bool fromJson(Input &&input);
+  // Writes JSON to `out` (see SaveData.cpp), byte-identical to a dump() of
+  // the equivalent nlohmann::json object, with its keys sorted ("version"
+  // last). `name` maps ItemIds to names.
+  template <typename Sink, typename Names>
+  static void toJson(Sink &out, const Amounts &items, const Amounts &upgrades,
+                     const Names &name, std::uint64_t sequence);
+
+  static std::string toBinary(const Snapshot &snapshot);
+  bool fromBinary(std::string_view data);
 
 public:
   static SaveData &instance() {
@@ -64,16 +216,18 @@ public:
   }
 
   struct ItemStack {
-    std::string id;
+    ItemId id;
     BigNum amount;
 
-    ItemStack(std::string_view id, const BigNum &amount)
-        : id{id}, amount{amount} {};
+    ItemStack(std::string_view name, const BigNum &amount)
+        : id{ItemRegistry::instance().intern(name)}, amount{amount} {};
+    ItemStack(ItemId id, const BigNum &amount) : id{id}, amount{amount} {};
     bool operator==(const ItemStack &other) const {
       return id == other.id && amount == other.amount;
     };
+    std::string_view name() const { return ItemRegistry::instance().name(id); }
     std::string to_string() const {
-      return std::format("{} {}x", id, amount.to_string());
+      return std::format("{} {}x", name(), amount.to_string());
     }
   };
 
@@ -82,27 +236,105 @@ public:
     BigNum lvl;
   };
 
-  const Map &getItems() const;
+  // Level k of an upgrade costs base * ratio^k of `currency`
+  struct UpgradeCost {
+    std::string_view currency;
+    BigNum base;
+    double ratio;
+  };
+
+  const Amounts &getItems() const;
 
+  // The ItemId overloads skip name lookups; use them in hot paths
+  BigNum getItem(ItemId id) const;
   BigNum getItem(const std::string_view id) const;
 
+  void setItem(ItemId id, const BigNum &amount);
   void setItem(const std::string_view id, const BigNum &amount);
 
+  void addItem(ItemId id, const BigNum &amount);
   void addItem(const std::string_view id, const BigNum &amount);
 
+  void subtractItem(ItemId id, const BigNum &amount);
   void subtractItem(const std::string_view id, const BigNum &amount);
 
-  const Map &getUpgrades() const;
+  const Amounts &getUpgrades() const;
 
+  BigNum getUpgradeLvl(ItemId id) const;
   BigNum getUpgradeLvl(const std::string_view id) const;
 
   void setUpgradeLvl(const std::string_view id, const BigNum &lvl);
 
+  void addUpgradeLvl(ItemId id, const BigNum &lvl);
   void addUpgradeLvl(const std::string_view id, const BigNum &lvl);
 
-  void serialize(std::ofstream &file) const;
+  // Buys up to `lvl` levels of `id` (as many as affordable by default),
+  // paying in cost.currency. Returns the number of levels bought, which is
+  // always finite: with shrinking costs, buying max stops once levels cost
+  // less than an ulp of the budget.
+  BigNum addUpgradeLvl(const std::string_view id, const UpgradeCost &cost,
+                       const BigNum &lvl = BigNum::inf());
+
+  // How many times `inputs` can be paid for: min(floor(have / need)) over
+  // the inputs, in one pass. inf() if there are no inputs.
+  BigNum maxCraftable(std::span<const ItemStack> inputs) const;
+
+  // Crafts up to `count` times (as many as affordable by default), with one
+  // scaled subtract per input and one add per output. Recipes without inputs
+  // are crafted once when no count is given. Returns the number crafted.
+  BigNum craft(std::span<const ItemStack> inputs,
+               std::span<const ItemStack> outputs,
+               const BigNum &count = BigNum::inf());
+
+  // .json files are written as JSON, anything else as binary
+  static Format formatFor(const std::filesystem::path &path);
+
+  // .lz4 files are compressed, in the format of the extension before it
+  // (save.json.lz4 is compressed JSON)
+  static Compression compressionFor(const std::filesystem::path &path);
+
+  // Files should be opened with std::ios::binary. Binary and compressed
+  // saves are encoded from a freshly published Snapshot.
+  void serialize(std::ofstream &file, Format format = Format::Binary,
+                 Compression compression = Compression::None);
+
+  // Publishes the current state as a new Snapshot, unless nothing changed
+  // since the last one, and returns the latest Snapshot. Tick thread only;
+  // the cost is one pointer per chunk, plus the names of new ItemIds.
+  std::shared_ptr<const Snapshot> publish();
+
+  // Publishes if view() was called since the last tick, so readers on
+  // other threads see fresh state without a Snapshot every tick. Tick
+  // thread only.
+  void publishViewed();
+
+  // The latest published Snapshot (nullptr before the first publish()),
+  // and a request for a fresh one on the next tick. Safe to call from any
+  // thread.
+  std::shared_ptr<const Snapshot> view() const {
+    viewed.store(true, std::memory_order_relaxed);
+    return published.load(std::memory_order_acquire);
+  }
+
+  // The file contents serialize() would write for `snapshot`
+  static std::string encode(const Snapshot &snapshot, Format format,
+                            Compression compression = Compression::None);
+
+  // Loads a binary or JSON save on top of the current state. On failure,
+  // logs the error (with its byte offset, for JSON), clears the state and
+  // returns false.
+  bool deserialize(std::ifstream &file);
+
+  // Journal mode: every addItem, subtractItem, setItem and addUpgradeLvl is
+  // also appended as a binary record (see Journal.hpp) for Autosave to log
+  void enableJournal();
+
+  // Moves out the records made since the last call
+  std::string takeJournal();
 
-  void deserialize(std::ifstream &file);
+  // Applies the records of a journal log that the loaded save doesn't have
+  // yet. Returns the number of records applied.
+  std::size_t replayJournal(std::ifstream &file);
 
   // Prevent copying and assignment
   SaveData(const SaveData &) = delete;
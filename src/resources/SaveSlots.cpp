@@ -0,0 +1,223 @@
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <system_error>
+
+#include "../Logger.hpp"
+#include "../game.hpp"
+#include "SaveSlots.hpp"
+
+namespace fs = std::filesystem;
+using namespace Save;
+
+namespace {
+
+std::int64_t unixTime(std::chrono::system_clock::time_point time) {
+  return std::chrono::duration_cast<std::chrono::seconds>(
+             time.time_since_epoch())
+      .count();
+}
+
+// Files in the save directory that aren't saves
+bool isSaveFile(const fs::directory_entry &entry) {
+  std::string file = entry.path().filename().string();
+  auto endsWith = [&](std::string_view suffix) {
+    return std::string_view(file).ends_with(suffix);
+  };
+  return entry.is_regular_file() && !file.starts_with('.') &&
+         file != SaveSlots::INDEX_FILE && !endsWith(".tmp") &&
+         !endsWith(".journal");
+}
+
+} // namespace
+
+SaveSlots &SaveSlots::instance() {
+  static SaveSlots instance;
+  return instance;
+}
+
+std::string SaveSlots::nameFor(const fs::path &file) {
+  std::string name = file.filename().string();
+  if (std::size_t dot = name.find('.'); dot != 0 && dot != name.npos) {
+    name.resize(dot);
+  }
+  return name;
+}
+
+bool SaveSlots::readIndex(const fs::path &path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  try {
+    json index = json::parse(file);
+    if (index.at("version").get<std::uint32_t>() != INDEX_VERSION) {
+      Logger::println("Warning: Unsupported save index version {}",
+                      index.at("version").dump());
+      return false;
+    }
+    for (const json &entry : index.at("slots")) {
+      Slot slot{
+          .name = entry.at("name").get<std::string>(),
+          .file = entry.at("file").get<std::string>(),
+          .lastPlayed = entry.at("last_played").get<std::int64_t>(),
+          .playtime = entry.at("playtime").get<std::int64_t>(),
+          .size = entry.at("size").get<std::uintmax_t>(),
+          .stats = std::nullopt,
+      };
+      if (entry.contains("bills")) {
+        slot.stats = Stats{
+            .bills = BigNum(entry.at("bills").get<std::string>()),
+            .items = entry.at("items").get<std::size_t>(),
+            .upgrades = BigNum(entry.at("upgrades").get<std::string>()),
+        };
+      }
+      slots.push_back(std::move(slot));
+    }
+  } catch (const std::exception &ex) {
+    Logger::println("Warning: Could not read save index {}: {}",
+                    path.string(), ex.what());
+    slots.clear();
+    return false;
+  }
+  return true;
+}
+
+void SaveSlots::open(const fs::path &dir) {
+  std::lock_guard lock(mutex);
+  directory = dir;
+  slots.clear();
+  selected.reset();
+  if (!readIndex(indexPath()) && fs::exists(indexPath())) {
+    Logger::println("Rebuilding save index from {}", directory.string());
+  }
+
+  // Forget saves that were deleted, and pick up ones copied in by hand
+  std::erase_if(slots, [&](Slot &slot) {
+    std::error_code ec;
+    fs::path path = directory / slot.file;
+    if (!fs::is_regular_file(path, ec)) {
+      return true;
+    }
+    slot.size = fs::file_size(path, ec);
+    return false;
+  });
+  std::error_code ec;
+  fs::directory_iterator files(directory, ec);
+  if (ec) {
+    Logger::println("Warning: Could not list saves in {}: {}",
+                    directory.string(), ec.message());
+    return;
+  }
+  for (const auto &entry : files) {
+    std::string file = entry.path().filename().string();
+    if (!isSaveFile(entry) ||
+        std::ranges::find(slots, file, &Slot::file) != slots.end()) {
+      continue;
+    }
+    auto modified = std::chrono::file_clock::to_sys(entry.last_write_time(ec));
+    slots.push_back(Slot{
+        .name = nameFor(file),
+        .file = file,
+        .lastPlayed = unixTime(modified),
+        .playtime = 0,
+        .size = entry.file_size(ec),
+        .stats = std::nullopt,
+    });
+  }
+}
+
+fs::path SaveSlots::indexPath() const { return directory / INDEX_FILE; }
+
+std::vector<SaveSlots::Slot> SaveSlots::list() const {
+  std::lock_guard lock(mutex);
+  std::vector<Slot> sorted = slots;
+  std::ranges::stable_sort(sorted, std::ranges::greater{}, &Slot::lastPlayed);
+  return sorted;
+}
+
+std::optional<SaveSlots::Slot> SaveSlots::find(std::string_view name) const {
+  std::lock_guard lock(mutex);
+  const Slot *found = nullptr;
+  for (const Slot &slot : slots) {
+    if (slot.name == name &&
+        (!found || slot.lastPlayed > found->lastPlayed)) {
+      found = &slot;
+    }
+  }
+  return found ? std::optional(*found) : std::nullopt;
+}
+
+void SaveSlots::select(const fs::path &savepath) {
+  std::lock_guard lock(mutex);
+  std::string file = savepath.filename().string();
+  auto it = std::ranges::find(slots, file, &Slot::file);
+  if (it == slots.end()) {
+    slots.push_back(Slot{
+        .name = nameFor(file),
+        .file = file,
+        .lastPlayed = 0,
+        .playtime = 0,
+        .size = 0,
+        .stats = std::nullopt,
+    });
+    it = std::prev(slots.end());
+  }
+  selected = static_cast<std::size_t>(it - slots.begin());
+  sessionStart = SteadyClock::now();
+}
+
+std::optional<std::string>
+SaveSlots::recordSave(const SaveData::Snapshot &snapshot, std::uintmax_t size) {
+  Stats stats{.bills = BigNum(0),
+              .items = snapshot.items.count(),
+              .upgrades = BigNum(0)};
+  // The writer thread can't use ItemRegistry, so look bills up by name
+  const auto &names = *snapshot.names;
+  auto bills = std::ranges::find(names, Items::BILLS);
+  if (bills != names.end()) {
+    auto id = static_cast<ItemId>(bills - names.begin());
+    if (const BigNum *amount = snapshot.items.find(id)) {
+      stats.bills = *amount;
+    }
+  }
+  for (const auto &[_, lvl] : snapshot.upgrades.entries()) {
+    stats.upgrades += lvl;
+  }
+
+  std::lock_guard lock(mutex);
+  if (!selected) {
+    return std::nullopt;
+  }
+  Slot &slot = slots[*selected];
+  // Count the session since the last save, so playtime survives a crash
+  auto played = std::chrono::floor<std::chrono::seconds>(SteadyClock::now() -
+                                                         sessionStart);
+  slot.playtime += played.count();
+  sessionStart += played;
+  slot.lastPlayed = unixTime(std::chrono::system_clock::now());
+  slot.size = size;
+  slot.stats = std::move(stats);
+  return encodeIndex();
+}
+
+std::string SaveSlots::encodeIndex() const {
+  json entries = json::array();
+  for (const Slot &slot : slots) {
+    json entry = {
+        {"name", slot.name},
+        {"file", slot.file},
+        {"last_played", slot.lastPlayed},
+        {"playtime", slot.playtime},
+        {"size", slot.size},
+    };
+    if (slot.stats) {
+      entry["bills"] = slot.stats->bills.serialize();
+      entry["items"] = slot.stats->items;
+      entry["upgrades"] = slot.stats->upgrades.serialize();
+    }
+    entries.push_back(std::move(entry));
+  }
+  json index = {{"version", INDEX_VERSION}, {"slots", std::move(entries)}};
+  return index.dump(2) + '\n';
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../BigNum.hpp"
+#include "SaveData.hpp"
+
+using namespace std::literals::string_view_literals;
+
+namespace Save {
+
+/*
+ * @class SaveSlots
+ * @brief Keeps an index of the saves in the save directory.
+ *
+ * Every save file in the directory is a slot, named after the file without
+ * its extensions. The index file caches what a slot list shows (when each
+ * slot was last played, for how long, its size and a few headline stats), so
+ * listing slots reads one small file instead of loading every save. Autosave
+ * rewrites the index atomically after each save of the selected slot.
+ */
+class SaveSlots { // Singleton class
+public:
+  static constexpr std::string_view INDEX_FILE = "index.json"sv;
+  static constexpr std::uint32_t INDEX_VERSION = 1;
+
+  struct Stats {
+    BigNum bills;
+    std::size_t items = 0; // Distinct items owned
+    BigNum upgrades;       // Total upgrade levels
+  };
+
+  struct Slot {
+    std::string name;
+    std::string file;            // Relative to the save directory
+    std::int64_t lastPlayed = 0; // Unix time, in seconds
+    std::int64_t playtime = 0;   // Seconds
+    std::uintmax_t size = 0;     // Bytes
+    // Saves found in the directory but not in the index have no stats until
+    // they are played again
+    std::optional<Stats> stats;
+  };
+
+private:
+  using SteadyClock = std::chrono::steady_clock;
+
+  std::filesystem::path directory;
+  std::vector<Slot> slots; // Index order
+  std::optional<std::size_t> selected;
+  SteadyClock::time_point sessionStart;
+  mutable std::mutex mutex; // The autosave writer records saves
+
+  // Private constructor for singleton
+  SaveSlots() = default;
+
+  // Deleted copy constructor and assignment operator
+  SaveSlots(const SaveSlots &) = delete;
+  SaveSlots &operator=(const SaveSlots &) = delete;
+
+  // Parses the index, or returns false if it is missing or malformed
+  bool readIndex(const std::filesystem::path &path);
+
+  // The index contents; the mutex must be held
+  std::string encodeIndex() const;
+
+public:
+  static SaveSlots &instance();
+
+  // Slot name for a save file, e.g. "save" for "save.json.lz4"
+  static std::string nameFor(const std::filesystem::path &file);
+
+  // Reads the index in `directory`, and reconciles it with the files there
+  // without opening any save
+  void open(const std::filesystem::path &directory);
+
+  std::filesystem::path indexPath() const;
+
+  // Slots, most recently played first
+  std::vector<Slot> list() const;
+
+  // The most recently played slot called `name`
+  std::optional<Slot> find(std::string_view name) const;
+
+  // Makes the save at `savepath` the selected slot, and starts counting its
+  // playtime
+  void select(const std::filesystem::path &savepath);
+
+  // Updates the selected slot after `snapshot` was saved as `size` bytes, and
+  // returns the new index contents to write. Returns std::nullopt if no slot
+  // is selected.
+  std::optional<std::string> recordSave(const SaveData::Snapshot &snapshot,
+                                        std::uintmax_t size);
+};
+
+} // namespace Save
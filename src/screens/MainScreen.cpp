@@ -42,14 +42,14 @@ void MainScreen::switchWindow(Subwindows target) {
 
 void MainScreen::refreshInventoryCounts() {
 
-  const SaveData::Map items = save.getItems();
+  const SaveData::Amounts &items = save.getItems();
+  const ItemRegistry &registry = ItemRegistry::instance();
 
   static size_t charsPerLine = COLS - 2;
   std::array<std::string, 3> display_lines({"", "", ""});
   int currLine = 0;
-  for (const auto &[item, num] : items) {
-    std::string count = num.to_pretty_string();
-    std::string entry = std::format("{}: {}", item, count);
+  for (const auto &[item, num] : items.entries()) {
+    std::string entry = std::format("{}: {:p}", registry.name(item), num);
     size_t entrySize = entry.size();
 
     // Set entry to first line that has enough space
@@ -89,41 +89,161 @@ void MainScreen::registerListener(
   inputListeners.insert_or_assign(input, listener);
 }
 
-bool MainScreen::attemptRecipe(SaveData &save, Recipes::Recipe recipe) {
+BigNum MainScreen::craftCount() const {
+  switch (craftAmount) {
+  case CraftAmount::One:
+    return BigNum(1);
+  case CraftAmount::Ten:
+    return BigNum(10);
+  case CraftAmount::Hundred:
+    return BigNum(100);
+  case CraftAmount::Max:
+    return BigNum::inf();
+  }
+  return BigNum(1);
+}
+
+bool MainScreen::attemptRecipe(SaveData &save, Recipes::RecipeId id,
+                               const BigNum &requested) {
+  const Recipes::Recipe &recipe = recipes.get(id);
+  BigNum count = requested;
 
-  // Check feasibility
-  for (const auto &input : recipe.inputs) {
-    if (save.getItem(input.id) < input.amount) {
-      notify(std::format("Not enough items: {}", input.id));
+  // Recipes from nothing have no intermediates to plan
+  if (autoCraft && !recipe.inputs.empty()) {
+    Planner &planner = Planner::instance();
+    if (count.is_inf()) {
+      count = planner.maxCrafts(id, save);
+    }
+    const Planner::Plan plan =
+        planner.plan(id, count > BigNum(0) ? count : BigNum(1), save);
+    if (!planner.execute(plan, save)) {
+      std::string missing;
+      for (const auto &stack : plan.missing) {
+        missing += std::format("{}{:p} {}", missing.empty() ? "" : ", ",
+                               stack.amount, stack.name());
+      }
+      notify(std::format("Missing: {}", missing));
       return false;
     }
+    notify(std::format("Crafted {:p}x {} in {} steps", count, recipe.id,
+                       plan.steps.size()));
+    return true;
   }
 
-  // Execute craft
-  for (const auto &input : recipe.inputs) {
-    save.subtractItem(input.id, input.amount);
+  const BigNum crafted = save.craft(recipe.inputs, recipe.outputs, count);
+  if (crafted == BigNum(0)) {
+    for (const auto &input : recipe.inputs) {
+      if (save.getItem(input.id) < input.amount) {
+        notify(std::format("Not enough items: {}", input.name()));
+        break;
+      }
+    }
+    return false;
   }
-  for (const auto &output : recipe.outputs) {
-    save.addItem(output.id, output.amount);
+  if (crafted != BigNum(1)) {
+    notify(std::format("Crafted {:p}x {}", crafted, recipe.id));
   }
   return true;
 }
 
+void MainScreen::refreshCraftingTitle() {
+  std::string_view label;
+  switch (craftAmount) {
+  case CraftAmount::One:
+    label = "x1";
+    break;
+  case CraftAmount::Ten:
+    label = "x10";
+    break;
+  case CraftAmount::Hundred:
+    label = "x100";
+    break;
+  case CraftAmount::Max:
+    label = "Max";
+    break;
+  }
+  (void)craftingWindow.setTitle(
+      std::format("Crafting ({}{}) [x] [a] Alt+key: max", label,
+                  autoCraft ? ", auto" : ""),
+      Window::Alignment::LEFT, GAME_COLORS::YELLOW_BLACK, 1);
+}
+
+void MainScreen::cycleCraftAmount() {
+  switch (craftAmount) {
+  case CraftAmount::One:
+    craftAmount = CraftAmount::Ten;
+    break;
+  case CraftAmount::Ten:
+    craftAmount = CraftAmount::Hundred;
+    break;
+  case CraftAmount::Hundred:
+    craftAmount = CraftAmount::Max;
+    break;
+  case CraftAmount::Max:
+    craftAmount = CraftAmount::One;
+    break;
+  }
+  refreshCraftingTitle();
+}
+
+void MainScreen::toggleAutoCraft() {
+  autoCraft = !autoCraft;
+  notify(autoCraft ? "Auto-craft on: missing intermediates are crafted first"
+                   : "Auto-craft off");
+  refreshCraftingTitle();
+}
+
+void MainScreen::refreshUpgrade(std::string_view id,
+                                const SaveData::UpgradeCost &cost) {
+  auto option = upgradeOptions.find(id);
+  if (option == upgradeOptions.end()) {
+    return;
+  }
+  const BigNum lvl = save.getUpgradeLvl(id);
+  const BigNum next = BigNum::geometric_sum(cost.base, cost.ratio, lvl, 1);
+  option->second.get().setText(
+      std::format("Example (lvl {:p}) - next: {:p} {} [b]uy, [B]uy max", lvl,
+                  next, cost.currency),
+      true);
+}
+
+void MainScreen::buyUpgrade(std::string_view id,
+                            const SaveData::UpgradeCost &cost,
+                            const BigNum &lvl) {
+  const BigNum bought = save.addUpgradeLvl(id, cost, lvl);
+  if (bought == BigNum(0)) {
+    notify(std::format("Not enough items: {}", cost.currency));
+    return;
+  }
+  notify(std::format("Bought {:p} levels of {}", bought, id));
+  refreshUpgrade(id, cost);
+}
+
 void MainScreen::addCraftingRecipe(char input,
                                    const std::span<Text::TextChunk> &init,
-                                   const Recipes::Recipe &recipe) {
+                                   Recipes::RecipeId recipe) {
   craftingWindow.putText(++numCraftingOptions, 1, init);
+  recipeKeys.insert_or_assign(input, recipe);
   registerListener(input, [recipe](MainScreen *scr, SaveData &save) {
-    scr->attemptRecipe(save, recipe);
+    scr->attemptRecipe(save, recipe, scr->craftCount());
   });
 }
 
-void MainScreen::addAllCraftingRecipes(const Recipes::RecipeSet &recipes) {
+void MainScreen::handleAltInput(char input) {
+  if (input == -1) {
+    return; // A lone ESC
+  }
+  if (auto i = recipeKeys.find(input); i != recipeKeys.end()) {
+    (void)attemptRecipe(save, i->second, BigNum::inf());
+    return;
+  }
+  notify(std::format("Unknown command: Alt+{} ({:d})", input, input));
+}
+
+void MainScreen::addAllCraftingRecipes(const Recipes &recipes) {
   char input = '1';
-  for (const auto &[id, recipe] :
-       Recipes::instance().getRecipes() | std::views::filter([](const auto &r) {
-         return r.second.recipe_type == "crafting";
-       })) {
+  for (Recipes::RecipeId id : recipes.ofType(Recipes::Type::Handcrafting)) {
+    const auto &recipe = recipes.get(id);
     std::string outputs{}, inputs{};
     bool first = true;
     for (const auto &output : recipe.outputs) {
@@ -154,7 +274,7 @@ void MainScreen::addAllCraftingRecipes(const Recipes::RecipeSet &recipes) {
                         std::format(" (requires: {})", inputs));
     }
 
-    addCraftingRecipe(input, text, recipe);
+    addCraftingRecipe(input, text, id);
 
     input++;
   }
@@ -189,11 +309,23 @@ MainScreen::MainScreen()
                                  GAME_COLORS::YELLOW_BLACK);
   (void)upgradesWindow.setTitle("Upgrades", Window::Alignment::LEFT,
                                 GAME_COLORS::RED_BLACK, 1);
-  upgradeOptions.emplace("example_upgrade",
+  upgradeOptions.emplace(EXAMPLE_UPGRADE,
                          upgradesWindow.putText(1, 1, "Example"s));
-  (void)craftingWindow.setTitle("Crafting", Window::Alignment::LEFT,
-                                GAME_COLORS::YELLOW_BLACK, 1);
-  addAllCraftingRecipes(recipes.getRecipes());
+  refreshUpgrade(EXAMPLE_UPGRADE, EXAMPLE_UPGRADE_COST);
+  registerListener('b', [](MainScreen *scr, SaveData &) {
+    scr->buyUpgrade(EXAMPLE_UPGRADE, EXAMPLE_UPGRADE_COST, BigNum(1));
+  });
+  registerListener('B', [](MainScreen *scr, SaveData &) {
+    scr->buyUpgrade(EXAMPLE_UPGRADE, EXAMPLE_UPGRADE_COST, BigNum::inf());
+  });
+  refreshCraftingTitle();
+  registerListener('x', [](MainScreen *scr, SaveData &) {
+    scr->cycleCraftAmount();
+  });
+  registerListener('a', [](MainScreen *scr, SaveData &) {
+    scr->toggleAutoCraft();
+  });
+  addAllCraftingRecipes(recipes);
   (void)sidebarCraftingWindow.putText(1, 1, "[C]rafting"s,
                                       GAME_COLORS::DEFAULT);
   (void)sidebarUpgradesWindow.putText(1, 1, "[U]pgrades"s,
@@ -234,6 +366,9 @@ void MainScreen::onTick() {
   case '\t':
     rotateWindows();
     return;
+  case ESC:
+    handleAltInput(ScreenManager::instance().getInput());
+    return;
   case -1:
     return;
   }
@@ -4,6 +4,7 @@
 #include "../render/Screen.hpp"
 #include "../render/Text.hpp"
 #include "../render/Window.hpp"
+#include "../resources/Planner.hpp"
 #include "../resources/Recipes.hpp"
 #include "../resources/SaveData.hpp"
 #include <array>
@@ -17,11 +18,13 @@
 #include <unordered_map>
 
 using namespace std::string_literals;
+using namespace std::string_view_literals;
 using namespace std::chrono_literals;
 
 class MainScreen : public Screen {
 private:
   static inline constexpr std::chrono::duration NOTIF_DURATION = 1.5s;
+  static inline constexpr char ESC = 27; // What Alt+<key> starts with
   Text &notifyText;
   std::optional<TimePoint> notifyStart;
 
@@ -31,7 +34,13 @@ private:
   Window &craftingWindow;
 
   Window &upgradesWindow;
-  std::map<std::string, std::reference_wrapper<Text>> upgradeOptions;
+  std::map<std::string, std::reference_wrapper<Text>, std::less<>>
+      upgradeOptions;
+
+  // Bought with [b] (one level) or [B] (as many as affordable)
+  static inline constexpr auto EXAMPLE_UPGRADE = "example_upgrade"sv;
+  static inline const SaveData::UpgradeCost EXAMPLE_UPGRADE_COST{
+      Items::BILLS, BigNum(10), 1.15};
 
   Window &sidebarCraftingWindow;
   Window &sidebarUpgradesWindow;
@@ -76,13 +85,43 @@ private:
   void registerListener(char input,
                         std::function<void(MainScreen *, SaveData &)> listener);
 
+  // Crafts per keypress, cycled with [x]. Alt+<recipe key> always crafts
+  // as many as possible.
+  enum class CraftAmount { One, Ten, Hundred, Max };
+  CraftAmount craftAmount = CraftAmount::One;
+
+  // Recipes by the key that crafts them
+  std::unordered_map<char, Recipes::RecipeId> recipeKeys;
+
+  // The count craftAmount stands for; inf() for Max
+  BigNum craftCount() const;
+
+  // Handles Alt+`input`, which curses reads as ESC followed by `input`
+  void handleAltInput(char input);
+
+  // Crafts missing intermediates first, toggled with [a]
+  bool autoCraft = false;
+
+  void refreshCraftingTitle();
+
+  void cycleCraftAmount();
+
+  void toggleAutoCraft();
+
   int numCraftingOptions = 0;
   void addCraftingRecipe(char input, const std::span<Text::TextChunk> &init,
-                         const Recipes::Recipe &recipe);
+                         Recipes::RecipeId recipe);
+
+  void addAllCraftingRecipes(const Recipes &recipes);
+
+  // Crafts `requested` times, or as many as possible if it is inf()
+  bool attemptRecipe(SaveData &save, Recipes::RecipeId id,
+                     const BigNum &requested);
 
-  void addAllCraftingRecipes(const Recipes::RecipeSet &recipes);
+  void refreshUpgrade(std::string_view id, const SaveData::UpgradeCost &cost);
 
-  bool attemptRecipe(SaveData &save, Recipes::Recipe recipe);
+  void buyUpgrade(std::string_view id, const SaveData::UpgradeCost &cost,
+                  const BigNum &lvl);
 
 public:
   virtual ~MainScreen() override = default;
@@ -0,0 +1,250 @@
+#include <fstream>
+#include <system_error>
+#include <utility>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "../Logger.hpp"
+#include "../resources/Journal.hpp"
+#include "Autosave.hpp"
+
+namespace fs = std::filesystem;
+using Save::SaveData;
+
+Autosave::Autosave() : writer([this] { writerLoop(); }) {}
+
+void Autosave::init() {
+  Logger::println("Starting autosave writer...");
+  (void)Autosave::instance();
+}
+
+Autosave &Autosave::instance() {
+  static Autosave instance;
+  return instance;
+}
+
+void Autosave::setSavePath(const fs::path &path) {
+  std::lock_guard lock(mutex);
+  savepath = path;
+  lastSave = Clock::now();
+}
+
+void Autosave::setJournalPath(const fs::path &path) {
+  std::lock_guard lock(mutex);
+  journalpath = path;
+  std::error_code ec;
+  journalSize = fs::exists(path, ec) ? fs::file_size(path, ec) : 0;
+  if (ec) {
+    journalSize = 0;
+  }
+}
+
+void Autosave::enqueue() {
+  // If a snapshot is still pending, it is replaced by this newer one
+  pending = SaveData::instance().publish();
+  wakeWriter.notify_one();
+}
+
+void Autosave::enqueueJournal() {
+  std::string taken = SaveData::instance().takeJournal();
+  if (taken.empty()) {
+    return;
+  }
+  if (records.empty()) {
+    records = std::move(taken);
+  } else {
+    records += taken;
+  }
+  wakeWriter.notify_one();
+}
+
+void Autosave::onTick() {
+  auto now = Clock::now();
+  bool journaling = journalpath.has_value();
+  if (now - lastSave < (journaling ? JOURNAL_INTERVAL : AUTOSAVE_INTERVAL)) {
+    return;
+  }
+
+  std::lock_guard lock(mutex);
+  if (!savepath) {
+    return;
+  }
+  lastSave = now;
+  if (!journaling) {
+    enqueue();
+    return;
+  }
+
+  enqueueJournal();
+  // Compact the log, unless a snapshot is already on its way
+  if (journalSize + records.size() > JOURNAL_COMPACT_SIZE && !pending &&
+      !writing) {
+    enqueue();
+  }
+}
+
+bool Autosave::saveNow() {
+  std::unique_lock lock(mutex);
+  if (!savepath) {
+    return false;
+  }
+  if (journalpath) {
+    enqueueJournal();
+  }
+  enqueue();
+  writeDone.wait(lock,
+                 [this] { return !pending && records.empty() && !busy; });
+  return lastSaved;
+}
+
+void Autosave::writerLoop() {
+  std::unique_lock lock(mutex);
+  while (true) {
+    wakeWriter.wait(lock, [this] {
+      return pending || !records.empty() || stopping;
+    });
+    if (!pending && records.empty()) {
+      return; // Stopping, nothing left to write
+    }
+    writing = std::exchange(pending, nullptr);
+    std::string log = std::exchange(records, {});
+    fs::path path = *savepath;
+    std::optional<fs::path> journal = journalpath;
+    std::uintmax_t size = journalSize;
+    busy = true;
+    lock.unlock();
+
+    bool saved = false;
+    bool wroteSave = false;
+    if (writing) {
+      const auto &snapshot = *writing;
+      std::string data =
+          SaveData::encode(snapshot, SaveData::formatFor(path),
+                           SaveData::compressionFor(path));
+      saved = writeAtomically(path, data);
+      wroteSave = saved;
+      if (saved) {
+        updateIndex(snapshot, data.size());
+      } else {
+        Logger::println("Error: Autosave to {} failed", path.string());
+      }
+      if (saved && journal) {
+        // The save now holds everything up to its sequence number, so the
+        // log only needs the records after it
+        log = Save::Journal::after(log, snapshot.sequence);
+        if (writeAtomically(*journal, log)) {
+          size = log.size();
+        } else {
+          saved = false; // Keep the old log, and append to it below
+        }
+      }
+    }
+    if (!saved && journal && !log.empty()) {
+      if (appendDurably(*journal, log)) {
+        size += log.size();
+      } else {
+        Logger::println("Error: Journal write to {} failed",
+                        journal->string());
+        size = JOURNAL_COMPACT_SIZE + 1; // Rewrite it with the next save
+      }
+    }
+
+    lock.lock();
+    journalSize = size;
+    if (writing) {
+      lastSaved = wroteSave;
+    }
+    writing.reset();
+    busy = false;
+    writeDone.notify_all();
+  }
+}
+
+void Autosave::updateIndex(const SaveData::Snapshot &snapshot,
+                           std::uintmax_t size) {
+  auto &slots = Save::SaveSlots::instance();
+  if (auto index = slots.recordSave(snapshot, size)) {
+    if (!writeAtomically(slots.indexPath(), *index)) {
+      // The save itself is fine; the next one rewrites the index
+      Logger::println("Error: Could not update save index {}",
+                      slots.indexPath().string());
+    }
+  }
+}
+
+// Writes `data` to a new, truncated or appended file and flushes it to disk
+static bool writeFile(const fs::path &path, std::string_view data,
+                      bool append) {
+#ifdef _WIN32
+  std::ofstream file(path, std::ios::binary |
+                               (append ? std::ios::app : std::ios::trunc));
+  file.write(data.data(), static_cast<std::streamsize>(data.size()));
+  file.flush();
+  return static_cast<bool>(file);
+#else
+  int fd = ::open(path.c_str(),
+                  O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC), 0644);
+  if (fd < 0) {
+    return false;
+  }
+  const char *pos = data.data();
+  std::size_t left = data.size();
+  while (left > 0) {
+    ssize_t written = ::write(fd, pos, left);
+    if (written < 0) {
+      ::close(fd);
+      return false;
+    }
+    pos += written;
+    left -= static_cast<std::size_t>(written);
+  }
+  if (::fsync(fd) != 0) {
+    ::close(fd);
+    return false;
+  }
+  ::close(fd);
+  return true;
+#endif
+}
+
+bool Autosave::appendDurably(const fs::path &path, std::string_view data) {
+  return writeFile(path, data, true);
+}
+
+bool Autosave::writeAtomically(const fs::path &path, std::string_view data) {
+  fs::path tmp = path;
+  tmp += ".tmp";
+  if (!writeFile(tmp, data, false)) {
+    return false;
+  }
+
+  std::error_code ec;
+  fs::rename(tmp, path, ec);
+  if (ec) {
+    Logger::println("Error: Could not replace {}: {}", path.string(),
+                    ec.message());
+    return false;
+  }
+
+#ifndef _WIN32
+  // Persist the rename itself
+  fs::path dir = path.parent_path().empty() ? "." : path.parent_path();
+  if (int dirfd = ::open(dir.c_str(), O_RDONLY); dirfd >= 0) {
+    (void)::fsync(dirfd);
+    ::close(dirfd);
+  }
+#endif
+  return true;
+}
+
+Autosave::~Autosave() {
+  {
+    std::lock_guard lock(mutex);
+    stopping = true;
+  }
+  wakeWriter.notify_one();
+  writer.join();
+}
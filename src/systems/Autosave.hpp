@@ -0,0 +1,107 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "../SystemManager.hpp"
+#include "../game.hpp"
+#include "../resources/SaveData.hpp"
+#include "../resources/SaveSlots.hpp"
+
+using namespace std::literals::string_view_literals;
+
+/*
+ * @class Autosave
+ * @brief Periodically saves the game without blocking the tick loop.
+ *
+ * Every AUTOSAVE_INTERVAL, the tick thread publishes a SaveData snapshot
+ * (a copy-on-write view, so this costs no copying) and hands it to a
+ * background writer thread, which encodes it, writes it to a temporary file,
+ * fsyncs it and renames it over the save. The tick thread never waits on
+ * disk I/O.
+ *
+ * In journal mode, the writer instead appends SaveData's journal records to
+ * a log next to the save every JOURNAL_INTERVAL, and only rewrites the save
+ * (emptying the log) once the log grows past JOURNAL_COMPACT_SIZE.
+ *
+ * After each save, the writer also updates the selected slot in the
+ * SaveSlots index.
+ */
+class Autosave : public System { // Singleton class
+private:
+  static inline constexpr std::chrono::duration AUTOSAVE_INTERVAL = 30s;
+  static inline constexpr std::chrono::duration JOURNAL_INTERVAL = 1s;
+  static inline constexpr std::uintmax_t JOURNAL_COMPACT_SIZE = 1 << 20;
+
+  std::optional<std::filesystem::path> savepath;
+  std::optional<std::filesystem::path> journalpath;
+  TimePoint lastSave = Clock::now();
+
+  using Snapshot = std::shared_ptr<const Save::SaveData::Snapshot>;
+
+  Snapshot pending;               // Snapshot waiting for the writer
+  Snapshot writing;               // Snapshot the writer is encoding
+  std::string records;            // Journal records waiting for the writer
+  std::uintmax_t journalSize = 0; // Bytes in the log on disk
+  bool busy = false;              // The writer is doing I/O
+  bool lastSaved = false;         // Whether the last save write succeeded
+  bool stopping = false;
+  std::mutex mutex;
+  std::condition_variable wakeWriter;
+  std::condition_variable writeDone;
+  std::thread writer;
+
+  // Private constructor for singleton
+  Autosave();
+
+  // Deleted copy constructor and assignment operator
+  Autosave(const Autosave &) = delete;
+  Autosave &operator=(const Autosave &) = delete;
+
+  // Publishes a SaveData snapshot for the writer; the mutex must be held
+  void enqueue();
+
+  // Hands SaveData's new journal records to the writer; the mutex must be held
+  void enqueueJournal();
+
+  void writerLoop();
+
+  // Records a save of `size` bytes in the save index
+  static void updateIndex(const Save::SaveData::Snapshot &snapshot,
+                          std::uintmax_t size);
+
+  static bool writeAtomically(const std::filesystem::path &path,
+                              std::string_view data);
+
+  static bool appendDurably(const std::filesystem::path &path,
+                            std::string_view data);
+
+public:
+  static constexpr std::string_view RESOURCE_ID = "Autosave"sv;
+
+  static void init();
+
+  static Autosave &instance();
+
+  // Autosaving starts once a save path is set
+  void setSavePath(const std::filesystem::path &path);
+
+  // Switches to journal mode, logging to `path`. SaveData::enableJournal()
+  // must be called too.
+  void setJournalPath(const std::filesystem::path &path);
+
+  // Saves the current state and waits until it is on disk. Returns false if
+  // the write failed.
+  bool saveNow();
+
+  void onTick() override;
+
+  virtual ~Autosave() override;
+};
@@ -0,0 +1,819 @@
+// Checks for the save code (formats, upgrades, LZ4, the journal and
+// migrations), for crafting plans and for production rates
+//
+// Usage: resource_checks <group> [data directory]
+//
+// Each group verifies results that the formats promise, or that earlier
+// versions got wrong, and exits with a failure if any differ. ctest runs
+// every group as its own test.
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <optional>
+#include <print>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../src/Logger.hpp"
+#include "../src/resources/Lz4.hpp"
+#include "../src/resources/Planner.hpp"
+#include "../src/resources/RateSolver.hpp"
+#include "../src/resources/Recipes.hpp"
+#include "../src/resources/SaveData.hpp"
+
+using namespace Save;
+
+// Errors the checks provoke on purpose go here instead of the game's log
+std::ofstream &Logger::out() {
+  static std::ofstream log("resource_checks.log");
+  return log;
+}
+
+namespace {
+
+// Where the game's data files are, for checks built on the real recipes
+std::filesystem::path dataDirectory = "data";
+
+struct Checker {
+  int failures = 0;
+
+  void expect(bool passed, std::string_view name, std::string_view detail) {
+    if (!passed) {
+      std::println(stderr, "FAIL {}: {}", name, detail);
+      ++failures;
+    }
+  }
+};
+
+std::filesystem::path tempPath(std::string_view name) {
+  return std::filesystem::temp_directory_path() /
+         std::format("resource_checks-{}", name);
+}
+
+// Calls `read` with `data` opened as a file, as the game reads saves
+template <typename Read> auto readFile(std::string_view data, Read &&read) {
+  const auto path = tempPath("file");
+  {
+    std::ofstream out(path, std::ios::binary);
+    out.write(data.data(), static_cast<std::streamsize>(data.size()));
+  }
+  std::ifstream in(path, std::ios::binary);
+  auto result = read(in);
+  in.close();
+  std::filesystem::remove(path);
+  return result;
+}
+
+// Loads `data` into SaveData
+bool load(std::string_view data) {
+  return readFile(data, [](std::ifstream &in) {
+    return SaveData::instance().deserialize(in);
+  });
+}
+
+// A failed load clears SaveData, so each round trip starts from nothing
+void clear() { (void)load(""); }
+
+// Every entry with its bits. With `asText`, amounts are what reading back
+// their serialize() text gives, which is what JSON saves keep.
+std::string describe(const SaveData::Snapshot &snapshot, bool asText = false) {
+  std::string out;
+  for (const auto *amounts : {&snapshot.items, &snapshot.upgrades}) {
+    for (const auto &[id, exact] : amounts->entries()) {
+      const BigNum amount = asText ? BigNum(exact.serialize()) : exact;
+      auto [m, e] = amount.to_bits();
+      out += std::format("{:?} = {} ({:x}, {:x}); ", snapshot.name(id),
+                         amount.to_string(), m, e);
+    }
+    out += "| ";
+  }
+  return out + std::format("sequence {}", snapshot.sequence);
+}
+
+// --- Saves ---
+
+// Values the formats have to keep, under names that need escaping in JSON
+void fillSave() {
+  SaveData &save = SaveData::instance();
+  save.enableJournal(); // Saves then carry a sequence number
+  save.setItem("quarter", BigNum(1) / BigNum(4));
+  save.setItem("tiny", BigNum(5) / BigNum(1.0, 300));
+  save.setItem("huge", BigNum(1.0, 400));
+  save.setItem("debt", -BigNum(1.0, 400));
+  save.setItem("negative", BigNum(-42));
+  save.setItem("zero", BigNum(0));
+  save.setItem("infinite", BigNum::inf());
+  save.setItem("\"quoted\" \\ name", BigNum(7));
+  save.setItem("tab\tnewline\ncontrol\x01\x1f", BigNum(1.5, 20));
+  save.setItem("unicode \xc3\xa9", BigNum(3));
+  save.addUpgradeLvl("upgrade \"one\"", BigNum(12));
+  save.addUpgradeLvl("upgrade\r\b\f", BigNum(2.5, 50));
+}
+
+void checkSaves(Checker &c) {
+  using Format = SaveData::Format;
+  using Compression = SaveData::Compression;
+  struct Case {
+    std::string_view name;
+    Format format;
+    Compression compression;
+    bool exact; // Every value round-trips bit for bit, not just its text
+  };
+  static constexpr Case CASES[] = {
+      {"binary", Format::Binary, Compression::None, true},
+      {"json", Format::Json, Compression::None, false},
+      {"binary+lz4", Format::Binary, Compression::Lz4, true},
+      {"json+lz4", Format::Json, Compression::Lz4, false},
+  };
+
+  SaveData &save = SaveData::instance();
+  fillSave();
+  const auto original = save.publish();
+  for (const Case &test : CASES) {
+    const std::string data =
+        SaveData::encode(*original, test.format, test.compression);
+    clear();
+    c.expect(load(data), test.name, "did not load");
+    const std::string got = describe(*save.publish());
+    const std::string expected = describe(*original, !test.exact);
+    c.expect(got == expected, test.name,
+             std::format("got\n  {}\nexpected\n  {}", got, expected));
+
+    // What was loaded encodes to the same file again
+    const std::string again =
+        SaveData::encode(*save.publish(), test.format, test.compression);
+    c.expect(again == data, std::format("{} re-encoded", test.name),
+             "differs from the first encoding");
+  }
+
+  // JSON saves are what dump() makes of the same object, "version" and all
+  json expected;
+  for (const auto &[key, amounts] :
+       {std::pair{"items", &original->items},
+        std::pair{"upgrades", &original->upgrades}}) {
+    json &category = expected[key] = json::object();
+    for (const auto &[id, amount] : amounts->entries()) {
+      category[std::string(original->name(id))] = amount.serialize();
+    }
+  }
+  expected["sequence"] = original->sequence;
+  expected["version"] = SCHEMA_VERSION;
+  c.expect(SaveData::encode(*original, Format::Json) == expected.dump(),
+           "json matches dump()", "differs");
+
+  clear();
+  c.expect(load(R"({"items":{"iron":"12abc","copper":"3e2"}})"),
+           "trailing characters", "did not load");
+  c.expect(save.getItem("iron") == BigNum(0) &&
+               save.getItem("copper") == BigNum(300),
+           "trailing characters",
+           std::format("loaded iron {}, copper {}",
+                       save.getItem("iron").to_string(),
+                       save.getItem("copper").to_string()));
+}
+
+// --- Upgrades ---
+
+void checkUpgrades(Checker &c) {
+  SaveData &save = SaveData::instance();
+  clear();
+
+  // Halving costs sum to 20 at most, so 100 bills cover every level. Buying
+  // max still buys a finite number of them, and pays for them.
+  const SaveData::UpgradeCost halving{"bills", BigNum(10), 0.5};
+  save.setItem("bills", BigNum(100));
+  const BigNum bought = save.addUpgradeLvl("halving", halving);
+  c.expect(bought > BigNum(0) && !bought.is_inf() && !bought.is_nan(),
+           "buy max of halving costs",
+           std::format("bought {} levels", bought.to_string()));
+  c.expect(save.getUpgradeLvl("halving") == bought, "buy max of halving costs",
+           "level differs from what was bought");
+  const BigNum left = save.getItem("bills");
+  c.expect(left >= BigNum(80) && left < BigNum(100),
+           "buy max of halving costs",
+           std::format("left {} bills, expected 80 to 100", left.to_string()));
+
+  // Buying a set number of levels is unchanged
+  c.expect(save.addUpgradeLvl("halving", halving, BigNum(2)) == BigNum(2),
+           "buy 2 levels of halving costs", "did not buy 2");
+}
+
+// --- LZ4 ---
+
+// Inputs that reach every path of the codec: blocks too short to match,
+// literal and match lengths around the 15 and 255 length-byte steps,
+// overlapping matches, offsets past the 64 KiB window, incompressible data
+// and a real save
+std::vector<std::pair<std::string, std::string>> lz4Inputs() {
+  std::mt19937 random(20240601); // Fixed, so failures reproduce
+  auto noise = [&random](std::size_t n) {
+    std::string out(n, '\0');
+    for (char &ch : out) {
+      ch = static_cast<char>(random() & 0xff);
+    }
+    return out;
+  };
+
+  std::vector<std::pair<std::string, std::string>> inputs;
+  for (std::size_t n : {0, 1, 4, 11, 12, 13, 16, 17, 18, 34, 35}) {
+    inputs.emplace_back(std::format("noise {}", n), noise(n));
+    inputs.emplace_back(std::format("run {}", n), std::string(n, 'a'));
+  }
+  for (std::size_t n : {14, 15, 16, 18, 19, 20, 269, 270, 271, 525, 70000}) {
+    std::string block = noise(n);
+    inputs.emplace_back(std::format("literals {}, repeated", n),
+                        block + "|" + block + noise(13));
+    inputs.emplace_back(std::format("run {}, then literals", n),
+                        std::string(n, 'x') + noise(n));
+  }
+  std::string pattern;
+  for (int i = 0; i < 5000; ++i) {
+    pattern += std::format("\"item {}\":\"{}e{}\",", i % 37, i, i % 300);
+  }
+  inputs.emplace_back("json-like", pattern);
+  // The first half matches nothing in reach of the second
+  std::string far = noise(70000);
+  inputs.emplace_back("beyond 64 KiB", far + noise(100) + far);
+  inputs.emplace_back("noise 256 KiB", noise(1 << 18));
+
+  SaveData &save = SaveData::instance();
+  for (int i = 0; i < 2000; ++i) {
+    save.setItem(std::format("ore {}", i), BigNum(1.5 + i, i % 400));
+  }
+  inputs.emplace_back(
+      "save", SaveData::encode(*save.publish(), SaveData::Format::Binary));
+  return inputs;
+}
+
+void checkLz4(Checker &c) {
+  std::mt19937 random(7);
+  for (const auto &[name, data] : lz4Inputs()) {
+    const std::string block = Lz4::compress(data);
+    const std::optional<std::string> back = Lz4::decompress(block, data.size());
+    c.expect(back && *back == data, name, "did not round-trip");
+
+    // The size must match exactly
+    c.expect(!Lz4::decompress(block, data.size() + 1), name,
+             "decompressed to a larger size");
+    if (!data.empty()) {
+      c.expect(!Lz4::decompress(block, data.size() - 1), name,
+               "decompressed to a smaller size");
+    }
+    (void)Lz4::decompress(block, SIZE_MAX);
+
+    // Corrupt and truncated blocks fail or decode to `size` bytes, without
+    // reading or writing out of bounds (which sanitized builds catch).
+    // Small blocks get every position, larger ones a sample.
+    const std::size_t step = block.size() <= 512 ? 1 : block.size() / 127;
+    for (std::size_t at = 0; at < block.size(); at += step) {
+      for (unsigned char flip : {0x01, 0x80, 0xff}) {
+        std::string corrupt = block;
+        corrupt[at] = static_cast<char>(corrupt[at] ^ flip);
+        auto got = Lz4::decompress(corrupt, data.size());
+        c.expect(!got || got->size() == data.size(),
+                 std::format("{}, byte {} ^ {:#x}", name, at, flip),
+                 "decoded to the wrong size");
+      }
+      auto got = Lz4::decompress(std::string_view(block).substr(0, at),
+                                 data.size());
+      c.expect(!got, std::format("{}, truncated to {}", name, at),
+               "decoded a truncated block");
+    }
+
+    // Random garbage appended to, or in place of, a block
+    std::string garbage = block;
+    for (int i = 0; i < 64; ++i) {
+      garbage.push_back(static_cast<char>(random() & 0xff));
+    }
+    auto got = Lz4::decompress(garbage, data.size());
+    c.expect(!got || got->size() == data.size(), name + ", trailing garbage",
+             "decoded to the wrong size");
+  }
+
+  // A save whose LZ4 block is cut short fails to load and clears SaveData
+  SaveData &save = SaveData::instance();
+  const std::string data =
+      SaveData::encode(*save.publish(), SaveData::Format::Binary,
+                       SaveData::Compression::Lz4);
+  c.expect(load(data), "compressed save", "did not load");
+  c.expect(!load(std::string_view(data).substr(0, data.size() - 10)),
+           "truncated compressed save", "loaded");
+  c.expect(save.getItems().count() == 0, "truncated compressed save",
+           "left items behind");
+}
+
+// --- Journal ---
+
+void checkJournal(Checker &c) {
+  using Journal::Op;
+  std::string log;
+  std::vector<std::size_t> ends; // End of each record
+  auto append = [&](Op op, std::string_view id, const BigNum &amount) {
+    Journal::append(log, {op, ends.size() + 1, id, amount});
+    ends.push_back(log.size());
+  };
+  append(Op::SetItem, "iron", BigNum(10));
+  append(Op::AddItem, "iron", BigNum(5));
+  append(Op::SubtractItem, "copper \"wire\"", BigNum(1.0, 400));
+  append(Op::AddUpgradeLvl, "speed", BigNum(1) / BigNum(4));
+
+  // Sequence numbers of the records forEach() reads, and the bytes consumed
+  auto read = [](std::string_view data) {
+    std::vector<std::uint64_t> seen;
+    std::size_t consumed = Journal::forEach(
+        data, [&](const Journal::Record &r) { seen.push_back(r.sequence); });
+    return std::pair{seen, consumed};
+  };
+  auto first = [](std::size_t n) {
+    std::vector<std::uint64_t> out;
+    for (std::uint64_t i = 1; i <= n; ++i) {
+      out.push_back(i);
+    }
+    return out;
+  };
+
+  bool same = true;
+  Journal::forEach(log, [&](const Journal::Record &r) {
+    if (r.sequence == 3) {
+      same = r.op == Op::SubtractItem && r.id == "copper \"wire\"" &&
+             r.amount.to_bits() == BigNum(1.0, 400).to_bits();
+    }
+  });
+  c.expect(same, "journal record", "fields differ from the appended ones");
+
+  // Cut anywhere, the log reads up to its last whole record
+  for (std::size_t cut = 0; cut <= log.size(); ++cut) {
+    std::size_t whole = 0;
+    while (whole < ends.size() && ends[whole] <= cut) {
+      ++whole;
+    }
+    auto [seen, consumed] = read(std::string_view(log).substr(0, cut));
+    c.expect(seen == first(whole) &&
+                 consumed == (whole ? ends[whole - 1] : 0),
+             std::format("journal cut at {}", cut),
+             std::format("read {} records, {} bytes", seen.size(), consumed));
+  }
+
+  // A corrupt record ends the log, even with valid records after it
+  for (std::size_t at = ends[0]; at < ends[1]; ++at) {
+    std::string corrupt = log;
+    corrupt[at] = static_cast<char>(corrupt[at] ^ 0x10);
+    auto [seen, consumed] = read(corrupt);
+    c.expect(seen == first(1) && consumed == ends[0],
+             std::format("journal corrupt at {}", at),
+             std::format("read {} records", seen.size()));
+  }
+
+  // after() keeps the records past a sequence number, byte for byte
+  c.expect(Journal::after(log, 0) == log, "after(0)", "dropped records");
+  c.expect(Journal::after(log, 2) == log.substr(ends[1]), "after(2)",
+           "differs from the last two records");
+  c.expect(Journal::after(log, 4).empty(), "after(4)", "kept records");
+  c.expect(Journal::after(log.substr(0, ends[3] - 1), 1) ==
+               log.substr(ends[0], ends[2] - ends[0]),
+           "after(1) of a torn log", "differs from records 2 and 3");
+
+  // Replaying applies only what the loaded save doesn't have
+  SaveData &save = SaveData::instance();
+  save.enableJournal();
+  save.setItem("ore", BigNum(100));
+  save.subtractItem("ore", BigNum(30));
+  save.addUpgradeLvl("drill", BigNum(1));
+  const std::string saved =
+      SaveData::encode(*save.publish(), SaveData::Format::Binary);
+  save.addItem("ore", BigNum(5));
+  save.addUpgradeLvl("drill", BigNum(2));
+  save.setItem("slag", BigNum(1) / BigNum(8));
+  const std::string expected = describe(*save.publish());
+  const std::string journal = save.takeJournal();
+
+  auto replay = [&save](std::string_view data) {
+    return readFile(
+        data, [&save](std::ifstream &in) { return save.replayJournal(in); });
+  };
+  clear();
+  c.expect(load(saved), "journaled save", "did not load");
+  std::size_t applied = replay(journal);
+  c.expect(applied == 3, "replayJournal",
+           std::format("applied {} records, expected 3", applied));
+  const std::string got = describe(*save.publish());
+  c.expect(got == expected, "replayJournal",
+           std::format("got\n  {}\nexpected\n  {}", got, expected));
+  c.expect(replay(journal) == 0, "replayJournal again", "applied records");
+  c.expect(save.takeJournal().empty(), "replayJournal",
+           "journaled the replayed records");
+
+  clear();
+  (void)load(saved);
+  applied = replay(std::string_view(journal).substr(0, journal.size() - 1));
+  c.expect(applied == 2, "replayJournal of a torn log",
+           std::format("applied {} records, expected 2", applied));
+
+  // A session without --journal replays the log and saves. That save
+  // carries the log's sequence number, so its records never apply again on
+  // top of what came after.
+  clear();
+  (void)load(saved);
+  (void)replay(journal);
+  const std::string folded =
+      SaveData::encode(*save.publish(), SaveData::Format::Binary);
+  clear();
+  (void)load(folded);
+  save.setItem("slag", BigNum(2));
+  const std::string later =
+      SaveData::encode(*save.publish(), SaveData::Format::Binary);
+  const std::string laterState = describe(*save.publish());
+  clear();
+  (void)load(later);
+  applied = replay(journal);
+  c.expect(applied == 0, "replayJournal after a non-journal save",
+           std::format("applied {} stale records", applied));
+  const std::string after = describe(*save.publish());
+  c.expect(after == laterState, "replayJournal after a non-journal save",
+           std::format("got\n  {}\nexpected\n  {}", after, laterState));
+  (void)save.takeJournal();
+}
+
+// --- Migration ---
+
+// Whether `name` has an entry in `amounts`
+bool has(const SaveData::Amounts &amounts, std::string_view name) {
+  auto id = ItemRegistry::instance().find(name);
+  return id && amounts.find(*id);
+}
+
+void checkMigration(Checker &c) {
+  using Category = Migration::Category;
+  const Migration old(1);
+  c.expect(old.apply(Category::Items, "Iron Gear") == "iron gear",
+           "migrate \"Iron Gear\"", "not renamed");
+  c.expect(old.apply(Category::Items, "ore") == "ore", "migrate \"ore\"",
+           "renamed an ID without a rename");
+  c.expect(old.apply(Category::Upgrades, "Iron") == "Iron",
+           "migrate upgrade \"Iron\"", "renamed in the wrong category");
+
+  // From every version, a Migration gives what running each step in turn
+  // would, and current IDs stay as they are
+  for (std::uint32_t version = 1; version <= SCHEMA_VERSION; ++version) {
+    const Migration migration(version);
+    for (const Migration::Step &step : Migration::steps()) {
+      for (const Migration::Rename &rename : step.renames) {
+        std::string_view id = rename.from;
+        for (const Migration::Step &later : Migration::steps()) {
+          for (const Migration::Rename &r : later.renames) {
+            if (later.version >= version && r.category == rename.category &&
+                r.from == id) {
+              id = r.to;
+            }
+          }
+        }
+        std::string_view got = migration.apply(rename.category, rename.from);
+        c.expect(got == id,
+                 std::format("migrate {:?} from version {}", rename.from,
+                             version),
+                 std::format("got {:?}, expected {:?}", got, id));
+      }
+    }
+  }
+
+  // JSON saves migrate their entries from "version", wherever it is. Those
+  // read before it move to their new IDs once it is known.
+  SaveData &save = SaveData::instance();
+  struct Case {
+    std::string_view name;
+    std::string_view json;
+    bool loads;
+    std::string_view item;    // Loaded as 5, if the save loads
+    std::string_view upgrade; // Loaded too, if not empty
+  };
+  static constexpr Case CASES[] = {
+      {"version last", R"({"items":{"Iron":"5"},"version":1})", true, "iron",
+       ""},
+      {"version first", R"({"version":1,"items":{"Iron":"5"}})", true, "iron",
+       ""},
+      {"no version", R"({"items":{"Iron":"5"}})", true, "iron", ""},
+      {"current version last", R"({"items":{"Iron":"5"},"version":2})", true,
+       "Iron", ""},
+      {"upgrades before version",
+       R"({"upgrades":{"Iron":"5"},"items":{"Copper":"5"},"version":1})",
+       true, "copper", "Iron"},
+      {"conflicting versions", R"({"version":1,"items":{},"version":2})",
+       false, "", ""},
+      {"unsupported version", R"({"items":{"Iron":"5"},"version":3})", false,
+       "", ""},
+  };
+  for (const Case &test : CASES) {
+    clear();
+    bool loaded = load(test.json);
+    c.expect(loaded == test.loads, test.name,
+             loaded ? "loaded" : "did not load");
+    if (!loaded || !test.loads) {
+      continue;
+    }
+    c.expect(save.getItem(test.item) == BigNum(5), test.name,
+             std::format("{:?} is {}", test.item,
+                         save.getItem(test.item).to_string()));
+    c.expect(save.getItems().count() == 1, test.name,
+             std::format("{} items, expected 1", save.getItems().count()));
+    c.expect(test.upgrade.empty() || has(save.getUpgrades(), test.upgrade),
+             test.name, std::format("no upgrade {:?}", test.upgrade));
+  }
+}
+
+// --- Planner ---
+
+ItemId item(std::string_view name) {
+  return ItemRegistry::instance().intern(name);
+}
+
+// Loads data/recipes.json, where a motor takes 2 iron gears (4 iron each)
+// and 10 copper wires (4 per copper)
+bool loadRecipes(Checker &c) {
+  bool loaded = Recipes::instance().load(dataDirectory);
+  c.expect(loaded, "recipes",
+           std::format("could not load {}", dataDirectory.string()));
+  return loaded;
+}
+
+Recipes::RecipeId addRecipe(std::string_view id, std::string_view input,
+                            std::string_view output, double outputs = 1) {
+  const std::array inputs{SaveData::ItemStack(input, BigNum(1))};
+  const std::array made{SaveData::ItemStack(output, BigNum(outputs))};
+  return Recipes::instance().add(id, Recipes::Type::Handcrafting, inputs,
+                                 made);
+}
+
+void checkPlanner(Checker &c) {
+  if (!loadRecipes(c)) {
+    return;
+  }
+  Recipes &recipes = Recipes::instance();
+  Planner &planner = Planner::instance();
+  SaveData &save = SaveData::instance();
+  const Recipes::RecipeId motor = *recipes.find("motor");
+
+  // Raw costs keep their fractions: a quarter of a copper per wire
+  for (const Planner::RawCost &cost : planner.rawCost(item("motor"))) {
+    double want = cost.id == item("iron") ? 8 : 2.5;
+    c.expect(cost.amount == FastBigNum(want),
+             std::format("motor raw cost in {}",
+                         ItemRegistry::instance().name(cost.id)),
+             std::format("got {}, expected {}", cost.amount.to_string(),
+                         want));
+  }
+
+  // A string count must be a whole number, or the recipe is rejected
+  try {
+    recipes.deserialize(json::parse(R"({"addRecipes": [{
+        "type": "handcrafting", "id": "bad count", "inputs": [],
+        "outputs": [{"item": "iron", "count": "12abc"}]}]})"));
+    c.expect(false, "recipe count \"12abc\"", "loaded");
+  } catch (const std::runtime_error &ex) {
+    c.expect(std::string_view(ex.what()).contains("invalid count"),
+             "recipe count \"12abc\"", ex.what());
+  }
+
+  // Every recipe makes something, however it is added
+  try {
+    (void)recipes.add("nothing", Recipes::Type::Handcrafting, {}, {});
+    c.expect(false, "recipe without outputs", "added");
+  } catch (const std::runtime_error &) {
+    c.expect(!recipes.find("nothing"), "recipe without outputs",
+             "added before throwing");
+  }
+
+  // 25 copper make 100 wires, for 10 motors; rounding each motor's 2.5
+  // copper up to 3 gave 8
+  save.setItem("copper", BigNum(25));
+  save.setItem("iron", BigNum(80));
+  const BigNum most = planner.maxCrafts(motor, save);
+  c.expect(most == BigNum(10), "maxCrafts(motor)",
+           std::format("got {}, expected 10", most.to_string()));
+  c.expect(planner.plan(motor, BigNum(10), save).feasible(), "plan 10 motors",
+           "not feasible");
+
+  // execute() runs every step of a plan, or none
+  const std::string before = describe(*save.publish());
+  const Planner::Plan tooMany = planner.plan(motor, BigNum(11), save);
+  c.expect(!tooMany.feasible() && !planner.execute(tooMany, save),
+           "execute 11 motors", "ran");
+  c.expect(describe(*save.publish()) == before, "execute 11 motors",
+           "changed the inventory");
+
+  // A plan the inventory no longer covers fails too, before any step runs
+  const Planner::Plan ten = planner.plan(motor, BigNum(10), save);
+  save.subtractItem("copper", BigNum(1));
+  const std::string spent = describe(*save.publish());
+  c.expect(!planner.execute(ten, save), "execute an outdated plan", "ran");
+  c.expect(describe(*save.publish()) == spent, "execute an outdated plan",
+           "changed the inventory");
+  save.addItem("copper", BigNum(1));
+  c.expect(planner.execute(ten, save), "execute 10 motors", "failed");
+  for (auto [name, want] : {std::pair{"motor", 10}, {"iron", 0}, {"copper", 0},
+                            {"iron gear", 0}, {"copper wire", 0}}) {
+    c.expect(save.getItem(name) == BigNum(want),
+             std::format("{} after 10 motors", name),
+             std::format("got {}, expected {}", save.getItem(name).to_string(),
+                         want));
+  }
+
+  // Cycles terminate (ctest times the group out otherwise). Ingots are
+  // smelted from slag, which is crushed from ingots, and springs and
+  // clocks are only made from each other.
+  const auto smelt = addRecipe("smelt", "slag", "ingot");
+  const auto crush = addRecipe("crush", "ingot", "slag", 2);
+  const auto wind = addRecipe("wind", "spring", "clock");
+  (void)addRecipe("unwind", "clock", "spring");
+  save.setItem("slag", BigNum(3));
+  save.setItem("ingot", BigNum(2));
+  for (auto [recipe, name] :
+       {std::pair{smelt, "smelt"}, {crush, "crush"}, {wind, "wind"}}) {
+    const BigNum n = planner.maxCrafts(recipe, save);
+    bool most = !n.is_inf() && !n.is_nan() &&
+                planner.plan(recipe, n, save).feasible() &&
+                !planner.plan(recipe, n + BigNum(1), save).feasible();
+    c.expect(most,
+             std::format("maxCrafts({}) in a cycle", name),
+             std::format("{} is not the most a plan allows", n.to_string()));
+  }
+  c.expect(planner.maxCrafts(wind, save) == BigNum(0), "maxCrafts(wind)",
+           "crafted clocks from nothing");
+  const BigNum crushes = planner.maxCrafts(crush, save);
+  c.expect(planner.execute(planner.plan(crush, crushes, save), save),
+           "execute crush", "failed");
+
+  // Shared intermediates get one node each. Every "a k" and "b k" takes one
+  // "a k-1" and one "b k-1", so a tree would have 2^40 nodes.
+  constexpr int DEPTH = 40;
+  std::optional<Recipes::RecipeId> top;
+  for (int k = 1; k <= DEPTH; ++k) {
+    const std::array inputs{
+        SaveData::ItemStack(std::format("a {}", k - 1), BigNum(1)),
+        SaveData::ItemStack(std::format("b {}", k - 1), BigNum(1))};
+    for (char kind : {'a', 'b'}) {
+      const std::array made{
+          SaveData::ItemStack(std::format("{} {}", kind, k), BigNum(1))};
+      top = recipes.add(std::format("make {} {}", kind, k),
+                        Recipes::Type::Handcrafting, inputs, made);
+    }
+  }
+  const double ores = 3 * std::ldexp(1.0, DEPTH - 1);
+  save.setItem("a 0", BigNum(ores));
+  save.setItem("b 0", BigNum(ores));
+  const Planner::Plan shared = planner.plan(*top, BigNum(1), save);
+  c.expect(shared.nodes.size() == 2 * DEPTH + 1, "shared intermediates",
+           std::format("{} nodes, expected {}", shared.nodes.size(),
+                       2 * DEPTH + 1));
+  c.expect(shared.steps.size() == 2 * DEPTH - 1, "shared intermediates",
+           std::format("{} steps, expected {}", shared.steps.size(),
+                       2 * DEPTH - 1));
+  const BigNum tops = planner.maxCrafts(*top, save);
+  c.expect(tops == BigNum(3), "maxCrafts over shared intermediates",
+           std::format("got {}, expected 3", tops.to_string()));
+  c.expect(planner.execute(planner.plan(*top, tops, save), save) &&
+               save.getItem("a 0") == BigNum(0),
+           "execute over shared intermediates", "failed");
+}
+
+// --- Rate solver ---
+
+// `got` is within 1e-9 of `want`, relatively
+bool near(const FastBigNum &got, double want) {
+  FastBigNum diff = got - FastBigNum(want);
+  if (diff < FastBigNum(0)) {
+    diff = -diff;
+  }
+  return !(diff > FastBigNum(1e-9 * (want < 0 ? -want : want) + 1e-12));
+}
+
+void checkSolver(Checker &c) {
+  if (!loadRecipes(c)) {
+    return;
+  }
+  const Recipes &recipes = Recipes::instance();
+  auto recipe = [&recipes](std::string_view id) { return *recipes.find(id); };
+  auto expectNear = [&c](std::string_view name, const FastBigNum &got,
+                         double want) {
+    c.expect(near(got, want), name,
+             std::format("got {}, expected {}", got.to_string(), want));
+  };
+
+  // Fractional speeds aren't rounded: 3 machines at half speed make 1.5
+  {
+    RateSolver solver;
+    (void)solver.add(recipe("iron"), BigNum(3), FastBigNum(0.5));
+    expectNear("3 x 0.5 iron", solver.rate(item("iron")).produced, 1.5);
+  }
+
+  // A motor takes 10 wires a second, and one wire maker makes 4 from 1
+  // copper. Iron and gears are plentiful, so wire is the only bottleneck.
+  RateSolver solver;
+  (void)solver.add(recipe("iron"), BigNum(8));
+  (void)solver.add(recipe("iron gear"), BigNum(2));
+  (void)solver.add(recipe("copper"), BigNum(1));
+  const auto wire = solver.add(recipe("copper wire"), BigNum(1));
+  const auto motors = solver.add(recipe("motor"), BigNum(1));
+  c.expect(solver.converged(), "motor chain", "did not converge");
+  expectNear("motor utilization", solver.utilization(motors), 0.4);
+  expectNear("wire utilization", solver.utilization(wire), 1);
+  expectNear("motors made", solver.rate(item("motor")).produced, 0.4);
+  expectNear("gears used", solver.rate(item("iron gear")).consumed, 0.8);
+  const auto bottlenecks = solver.bottlenecks();
+  c.expect(bottlenecks.size() == 1 &&
+               bottlenecks[0].item == item("copper wire"),
+           "motor chain bottlenecks", "expected copper wire alone");
+  if (!bottlenecks.empty()) {
+    expectNear("wire satisfied", bottlenecks[0].satisfied, 0.4);
+    expectNear("wire shortfall", bottlenecks[0].shortfall, 6);
+  }
+
+  // setCount() re-solves what the change reaches, to what a solver built
+  // with the new counts gives
+  for (int wires : {2, 3, 1}) {
+    solver.setCount(wire, BigNum(wires));
+    RateSolver fresh;
+    (void)fresh.add(recipe("iron"), BigNum(8));
+    (void)fresh.add(recipe("iron gear"), BigNum(2));
+    (void)fresh.add(recipe("copper"), BigNum(1));
+    (void)fresh.add(recipe("copper wire"), BigNum(wires));
+    (void)fresh.add(recipe("motor"), BigNum(1));
+
+    const auto rates = solver.rates();
+    const auto want = fresh.rates();
+    bool same = rates.size() == want.size();
+    for (std::size_t i = 0; same && i < rates.size(); ++i) {
+      same = rates[i].item == want[i].item &&
+             near(rates[i].produced, want[i].produced.as_double()) &&
+             near(rates[i].consumed, want[i].consumed.as_double());
+    }
+    c.expect(same, std::format("setCount to {} wire makers", wires),
+             "rates differ from a fresh solve");
+  }
+  // Back at 1 wire maker, wire limits motors as before
+  expectNear("motors made with 1 wire maker",
+             solver.rate(item("motor")).produced, 0.4);
+}
+
+struct Group {
+  std::string_view name;
+  std::function<void(Checker &)> run;
+};
+
+const std::vector<Group> &groups() {
+  static const std::vector<Group> all = {
+      {"saves", checkSaves},
+      {"upgrades", checkUpgrades},
+      {"lz4", checkLz4},
+      {"journal", checkJournal},
+      {"migration", checkMigration},
+      {"planner", checkPlanner},
+      {"solver", checkSolver},
+  };
+  return all;
+}
+
+void usage(const char *program) {
+  std::string names;
+  for (const Group &group : groups()) {
+    names += names.empty() ? "" : "|";
+    names += group.name;
+  }
+  std::println(stderr, "Usage: {} <{}> [data directory]", program, names);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc != 2 && argc != 3) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+  if (argc == 3) {
+    dataDirectory = argv[2];
+  }
+  for (const Group &group : groups()) {
+    if (group.name != argv[1]) {
+      continue;
+    }
+    Checker c;
+    group.run(c);
+    if (c.failures > 0) {
+      std::println(stderr, "{} checks failed", c.failures);
+      return EXIT_FAILURE;
+    }
+    std::println("All {} checks passed", group.name);
+    return EXIT_SUCCESS;
+  }
+  usage(argv[0]);
+  return EXIT_FAILURE;
+}